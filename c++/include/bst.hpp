@@ -1,14 +1,26 @@
 #ifndef bst_hpp
 #define bst_hpp
 
+#include <cstdint>
 #include <iostream>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
 #include <utility>
 #include <vector>
 #include <memory>
 #include <iterator>
 #include<sstream>
+#include <fstream>
+#include <cstring>
 #include "node.hpp"
 #include "iterator.hpp"
+#include "node_handle.hpp"
+#include "parallel.hpp"
+#include "serializer.hpp"
+#include "pool.hpp"
+#include "frozen.hpp"
 
 template<typename T>
 class node;                  // structure of a node inside the tree (see node.hpp)
@@ -17,150 +29,727 @@ template<typename N, typename T>          // class iterator (see iterator.hpp)
 class _iterator;
 
 
+// ========================= BALANCING POLICIES ===========================
+//
+// Tags selecting how the tree keeps itself balanced.
+// With no_balancing (the default) the shape of the tree only depends on
+// the order of the insertions and balance() has to be called by hand.
+// With red_black_balancing the tree is a red-black tree: insert and erase
+// recolour and rotate the nodes so that the height stays O(log n).
+
+struct no_balancing {};
+
+struct red_black_balancing {};
+
+
+// ============================ SORTED UNIQUE =============================
+//
+// Tag telling the range constructor of bst that the pairs are already
+// sorted by key (according to the comparison operator of the tree) and
+// that there are no duplicate keys.
+
+struct sorted_unique_t { explicit sorted_unique_t() = default; };
+
+constexpr sorted_unique_t sorted_unique{};
+
+
+// ============================ PARALLEL BUILD ============================
+//
+// Tag selecting the constructor of bst that builds the tree out of a
+// range of pairs in any order using several threads.
+
+struct parallel_build_t { explicit parallel_build_t() = default; };
+
+constexpr parallel_build_t parallel_build{};
+
+
 // ============================== BST CLASS ===============================
 // 
 // This class represents the concept of a binary search tree, it is 
-// templated on the type of the key, the type of the value and the
-// comparison operator, which has a default value.
+// templated on the type of the key, the type of the value, the
+// comparison operator, the allocator used for the nodes and the
+// balancing policy, which have a default value.
+// Any standard allocator can be used, the nodes are obtained by rebinding
+// it; with pool_allocator (see pool.hpp) the nodes are carved out of large
+// contiguous chunks and clear() gives all of them back at once.
 
 
-template<typename key_type, typename value_type, typename comparison_type = std::less<key_type> >
+template<typename key_type, typename value_type, typename comparison_type = std::less<key_type>,
+         typename allocator_type = std::allocator<std::pair<const key_type, value_type>>,
+         typename balancing_policy = no_balancing >
 class bst{
   
   public:
   using pair_type = typename std::pair<const key_type, value_type>;
   using iterator = _iterator<pair_type, pair_type>;
   using const_iterator = _iterator<pair_type, const pair_type>;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  private:
+  using node_allocator = typename std::allocator_traits<allocator_type>::template rebind_alloc<node<pair_type>>;
+  using node_traits = std::allocator_traits<node_allocator>;
+
+  public:
+  using node_type = _node_handle<pair_type, node_allocator>;
+
+  // result of the insertion of a node handle: where the key is, whether
+  // the node has been inserted and, if not, the handle still owning it
+  struct insert_return_type{
+    iterator position;
+    bool inserted;
+    node_type node;
+  };
 
   private:
-  
   comparison_type op;		    // comparison operator
+
+  node_allocator alloc;		    // allocator of the nodes
   
-  std::unique_ptr<node<pair_type>> root;       // pointer to the root node
-  
-  //============================== _COPY ===============================
+  node<pair_type>* root;	    // pointer to the root node
+
+  node<pair_type>* leftmost;	    // pointer to the node with the smallest key
+
+  node<pair_type>* rightmost;	    // pointer to the node with the largest key
+
+  std::size_t node_count;	    // number of nodes allocated by the tree
+
+  //=========================== _CREATE_NODE ============================
   //
-  // A private auxiliary function used to recursively copy a tree by 
-  // performing a deep copy of the nodes.
-  
-  void _copy(std::unique_ptr<node<pair_type>>& n){
-    
-    insert(n.get() -> pair);	    // insert the value-key pair for the node passed in the
-                                    // copy tree, creating a new node inside it
+  // A private auxiliary function that allocates a new node through the
+  // allocator and constructs it in place with the given arguments.
 
-    if( n.get()->left ){            // if the passed node has a left child copy it
-    
-      _copy(n.get() -> left);       // recursive call to this function
+  template<typename... Types>
+  node<pair_type>* _create_node(Types&&... args){
+
+    // the subtree sizes stored in the nodes are 32 bit wide
+    if(node_count == std::numeric_limits<std::uint32_t>::max()){ throw std::length_error{"bst: too many nodes"}; }
+
+    node<pair_type>* n = node_traits::allocate(alloc, 1);
+
+    try{
+      node_traits::construct(alloc, n, std::forward<Types>(args)...);
+
+    }catch(...){
+
+      node_traits::deallocate(alloc, n, 1);    // give the memory back if the pair throws
+      throw;
+    }
+
+    ++node_count;
+    return n;
+  }
+
+  //=========================== _DESTROY_NODE ===========================
+  //
+  // A private auxiliary function that destroys a single node and gives
+  // its memory back to the allocator.
+
+  void _destroy_node(node<pair_type>* n) noexcept{
+
+    node_traits::destroy(alloc, n);
+    node_traits::deallocate(alloc, n, 1);
+    --node_count;
+  }
+
+  //============================= _DESTROY ==============================
+  //
+  // A private auxiliary function that destroys the subtree rooted in n
+  // without recursion, so that the stack usage does not depend on the
+  // height of the tree: we go down to a leaf, destroy it after unlinking
+  // it from its parent and go back up to the parent, until the root of
+  // the subtree is destroyed as well. If the memory is not freed node by
+  // node it is only given back later, all at once, by the allocator (see
+  // _free_all).
+
+  void _destroy(node<pair_type>* n, bool free_memory) noexcept{
+
+    auto tmp = n;
+
+    while(tmp){
+
+      if(tmp->left){			// go down to a leaf
+
+        tmp = tmp->left;
+
+      }else if(tmp->right){
+
+        tmp = tmp->right;
+
+      }else{				// unlink the leaf and destroy it
+
+        auto up = (tmp == n) ? nullptr : tmp->parent;
+
+        if(up){
+
+          if(up->left == tmp){ up->left = nullptr; }
+          else{ up->right = nullptr; }
+        }
+
+        if(free_memory){
+
+          _destroy_node(tmp);
+
+        }else{
+
+          node_traits::destroy(alloc, tmp);
+          --node_count;
+        }
+
+        tmp = up;
+      }
+    }
+  }
+
+  //============================ _FREE_ALL ==============================
+  //
+  // A private auxiliary function that destroys all the nodes of the tree.
+  // When the allocator can release all its memory at once and all the
+  // memory it handed out belongs to this tree, the nodes are only
+  // destroyed (not even visited, if the pairs have a trivial destructor)
+  // and then the whole pool is released; otherwise they are freed one by
+  // one.
+
+  void _free_all(std::true_type) noexcept{
+
+    if(alloc.in_use() == node_count){
+
+      if(!std::is_trivially_destructible<node<pair_type>>::value){ _destroy(root, false); }
+
+      node_count = 0;
+      alloc.release();
+
+    }else{
+
+      _destroy(root, true);
     }
-    if( n.get()->right ){           // if the passed node has a right child copy it
+  }
+
+  void _free_all(std::false_type) noexcept{ _destroy(root, true); }
+
+  //============================== _SIZE ================================
+  //
+  // Private auxiliary functions for the sizes of the subtrees stored in
+  // the nodes: _size returns the size of the subtree rooted in n (0 for
+  // nullptr), _grow and _shrink add or remove one to the size of n and
+  // of all its ancestors, after a node has been linked or unlinked below
+  // n. Insertion only calls _grow once the new node has been created, so
+  // looking for a key already present writes nothing on the way down.
+
+  static std::size_t _size(const node<pair_type>* n) noexcept{ return n ? n->size : 0; }
+
+  static void _grow(node<pair_type>* n) noexcept{ for(; n; n = n->parent){ ++n->size; } }
+
+  static void _shrink(node<pair_type>* n) noexcept{ for(; n; n = n->parent){ --n->size; } }
+
+  //============================= _REPLACE ==============================
+  //
+  // A private auxiliary function that puts the subtree rooted in n in
+  // place of the subtree rooted in old, linking it to the parent of old
+  // (or making it the new root).
+
+  void _replace(node<pair_type>* old, node<pair_type>* n) noexcept{
+
+    if(!old->parent){			// old was the root
+
+      root = n;
 
-      _copy(n.get() -> right);      // recursive call
+    }else if(old == old->parent->left){
+
+      old->parent->left = n;
+
+    }else{
+
+      old->parent->right = n;
     }
 
-    return;			    // once we have that the node has no more children we have
-				    // finished to copy
+    if(n){ n->parent = old->parent; }
   }
- 
-  //============================= _INSERT ==============================
+
+  //========================== _ROTATE_LEFT =============================
   //
-  // A private auxiliary function that performs insertion of a new node
-  // in the tree, given a key-value pair. It has been introduced to 
-  // exploit forwarding reference, avoiding code duplication.
-  
-  template<typename O>
-  std::pair<iterator, bool> _insert(O&& x){
+  // A private auxiliary function that rotates the subtree rooted in x to
+  // the left: the right child of x takes its place and x becomes its
+  // left child.
+
+  void _rotate_left(node<pair_type>* x) noexcept{
+
+    auto y = x->right;
+
+    x->right = y->left;			// the left subtree of y goes under x
+    if(y->left){ y->left->parent = x; }
+
+    _replace(x, y);			// y takes the place of x
+
+    y->left = x;
+    x->parent = y;
+
+    y->size = x->size;			// y roots the same nodes x did
+    x->size = _size(x->left) + _size(x->right) + 1;
+  }
+
+  //========================== _ROTATE_RIGHT ============================
+  //
+  // Mirror image of _rotate_left.
+
+  void _rotate_right(node<pair_type>* x) noexcept{
+
+    auto y = x->left;
+
+    x->left = y->right;			// the right subtree of y goes under x
+    if(y->right){ y->right->parent = x; }
+
+    _replace(x, y);			// y takes the place of x
+
+    y->right = x;
+    x->parent = y;
+
+    y->size = x->size;
+    x->size = _size(x->left) + _size(x->right) + 1;
+  }
+
+  //========================= _INSERT_FIXUP =============================
+  //
+  // A private auxiliary function called on each newly linked node.
+  // Without balancing nothing has to be done, for a red-black tree the
+  // new node is coloured red and the red-black properties are restored
+  // going up the tree, with at most two rotations.
+
+  void _insert_fixup(node<pair_type>*, no_balancing) noexcept{}
+
+  void _insert_fixup(node<pair_type>* z, red_black_balancing) noexcept{
+
+    _fix_red(z);
+    root->red = false;			// the root is always black
+  }
+
+  // makes z red and restores the constraint on red nodes above it, with
+  // recolourings and rotations that preserve the black height of every
+  // subtree; the root may be left red
+  void _fix_red(node<pair_type>* z) noexcept{
+
+    z->red = true;
+
+    while(z->parent && z->parent->red){	// a red node cannot have a red parent
+
+      auto p = z->parent;
+      auto g = p->parent;		// p is red so it is not the root
+
+      if(p == g->left){
+
+        auto u = g->right;		// uncle of z
+
+        if(u && u->red){		// red uncle: push the blackness down from g
+
+          p->red = false;
+          u->red = false;
+          g->red = true;
+          z = g;
+
+        }else{				// black uncle: one or two rotations
+
+          if(z == p->right){
+
+            z = p;
+            _rotate_left(z);
+            p = z->parent;
+          }
+
+          p->red = false;
+          g->red = true;
+          _rotate_right(g);
+        }
 
-  auto tmp = root.get();
+      }else{				// mirror image of the case above
 
-  while(tmp){     			   		// while tmp != nullptr					   
+        auto u = g->left;
 
-    if(op(x.first, tmp -> pair.first)){    		// if the inserted key is smaller than the root key
-		                                        // according to the comparison type
+        if(u && u->red){
 
-      if(tmp -> left){			   		// if there is a left child
+          p->red = false;
+          u->red = false;
+          g->red = true;
+          z = g;
 
-        tmp = tmp->left.get();		   		// go down on the left
+        }else{
 
-      }else{				   		// the left child is not present
+          if(z == p->left){
 
-        // create a new node initialized with the given key-value pair
-        // and return a pair iterator_to_the_node - true
+            z = p;
+            _rotate_right(z);
+            p = z->parent;
+          }
+
+          p->red = false;
+          g->red = true;
+          _rotate_left(g);
+        }
+      }
+    }
+  }
+
+  //========================== _ERASE_FIXUP =============================
+  //
+  // A private auxiliary function called after a black node has been
+  // unlinked from the tree; x is the node that took its place (possibly
+  // nullptr) and x_parent its parent. Without balancing nothing has to be
+  // done, for a red-black tree the missing black node is given back to
+  // the path through recolourings and at most three rotations.
+
+  void _erase_fixup(node<pair_type>*, node<pair_type>*, no_balancing) noexcept{}
+
+  void _erase_fixup(node<pair_type>* x, node<pair_type>* x_parent, red_black_balancing) noexcept{
+
+    while(x != root && (!x || !x->red)){
+
+      if(x == x_parent->left){
+
+        auto w = x_parent->right;	// sibling of x, it exists since x misses a black node
+
+        if(w->red){			// red sibling: make it black by a rotation
+
+          w->red = false;
+          x_parent->red = true;
+          _rotate_left(x_parent);
+          w = x_parent->right;
+        }
+
+        if( (!w->left || !w->left->red) && (!w->right || !w->right->red) ){
+
+          w->red = true;		// both nephews black: move the problem up
+          x = x_parent;
+          x_parent = x->parent;
+
+        }else{
+
+          if(!w->right || !w->right->red){
+
+            w->left->red = false;	// make the far nephew red
+            w->red = true;
+            _rotate_right(w);
+            w = x_parent->right;
+          }
+
+          w->red = x_parent->red;	// the far nephew is red: one rotation fixes it
+          x_parent->red = false;
+          w->right->red = false;
+          _rotate_left(x_parent);
+          x = root;
+        }
+
+      }else{				// mirror image of the case above
+
+        auto w = x_parent->left;
+
+        if(w->red){
+
+          w->red = false;
+          x_parent->red = true;
+          _rotate_right(x_parent);
+          w = x_parent->left;
+        }
+
+        if( (!w->left || !w->left->red) && (!w->right || !w->right->red) ){
+
+          w->red = true;
+          x = x_parent;
+          x_parent = x->parent;
+
+        }else{
 
-        tmp -> left.reset(new node<pair_type>{tmp, std::forward<O>(x)});
-        return std::make_pair<iterator, bool>(iterator{tmp}, true);
+          if(!w->left || !w->left->red){
+
+            w->right->red = false;
+            w->red = true;
+            _rotate_left(w);
+            w = x_parent->left;
+          }
+
+          w->red = x_parent->red;
+          x_parent->red = false;
+          w->left->red = false;
+          _rotate_right(x_parent);
+          x = root;
+        }
+      }
+    }
+
+    if(x){ x->red = false; }
+  }
+
+  //============================== _CLONE ==============================
+  //
+  // A private auxiliary function that performs a deep copy of the tree
+  // rooted in x and returns the root of the copy, which has exactly the
+  // same shape (and colours) as the original one. The two trees are
+  // visited together without recursion: from each node we go down to the
+  // first child that has not been copied yet, creating its copy, and
+  // when both children are done we go back up through the parent links.
+  // Each node is created once, right after its parent, so with a
+  // pool_allocator the copy ends up in contiguous memory.
+
+  node<pair_type>* _clone(const node<pair_type>* x){
+
+    if(!x){ return nullptr; }
+
+    auto copy = _create_node(nullptr, x->pair);
+    copy->red = x->red;
+    copy->size = x->size;
+
+    auto from = x;			// node of the original tree
+    auto to = copy;			// corresponding node of the copy
+
+    try{
+
+      while(true){
+
+        if(from->left && !to->left){		// copy the left child and go down
+
+          to->left = _create_node(to, from->left->pair);
+          to->left->red = from->left->red;
+          to->left->size = from->left->size;
+          from = from->left;
+          to = to->left;
+
+        }else if(from->right && !to->right){	// copy the right child and go down
+
+          to->right = _create_node(to, from->right->pair);
+          to->right->red = from->right->red;
+          to->right->size = from->right->size;
+          from = from->right;
+          to = to->right;
+
+        }else if(from != x){			// both children done, go up
+
+          from = from->parent;
+          to = to->parent;
+
+        }else{
+
+          break;
+        }
       }
 
-    }else if( op( tmp -> pair.first, x.first)){		// if the inserted key is greater than the root key
-                                                        // according to the comparison type
+    }catch(...){
+
+      _destroy(copy, true);		// do not leak the part already copied
+      throw;
+    }
+
+    return copy;
+  }
+ 
+  //============================= _DESCEND =============================
+  //
+  // A private auxiliary function that looks for the place of the key x
+  // in the tree, without modifying it. If the key is already present its
+  // node is returned; otherwise nullptr is returned, and parent and left
+  // tell where the new node has to be linked (parent is nullptr if the
+  // tree is empty), after _grow(parent) has counted it in the sizes.
+
+  template<typename K>
+  node<pair_type>* _descend(const K& x, node<pair_type>*& parent, bool& left){
 
-      if(tmp -> right){					// if there is a right child
+    auto tmp = root;
+    parent = nullptr;
+    left = false;
 
-        tmp = tmp->right.get();				// go down on the right
+    while(tmp){     			   		// while tmp != nullptr
 
-      }else{						// the right child is not present
+      parent = tmp;
 
-        // create a new node initialized with the given key-value pair
-        // and return a pair iterator_to_the_node - true
+      if(op(x, tmp -> pair.first)){    		// if the inserted key is smaller than the node key
 
-        tmp -> right.reset(new node<pair_type>{tmp, std::forward<O>(x)});
-        return std::make_pair<iterator, bool>(iterator{tmp}, true);
+        left = true;
+        tmp = tmp->left;		   		// go down on the left
+
+      }else if( op( tmp -> pair.first, x)){		// if the inserted key is greater than the node key
+
+        left = false;
+        tmp = tmp->right;				// go down on the right
+
+      }else{						// the key is already present
+
+        return tmp;
       }
+    }
+
+    return nullptr;
+  }
+
+  //=============================== _LINK ==============================
+  //
+  // A private auxiliary function that links the unlinked node n as the
+  // left or right child of parent (or as the root if parent is nullptr),
+  // updating the cached extrema, and then restores the balance. The sizes
+  // of the ancestors of n must already count it.
+
+  void _link(node<pair_type>* n, node<pair_type>* parent, bool left) noexcept{
+
+    n->parent = parent;
+
+    if(!parent){					// the tree was empty
 
-    }else{						
+      root = n;
+      leftmost = n;
+      rightmost = n;
 
-      // in case the key is already present return a pair iterator_to_the_node_false
-      
-      return std::make_pair<iterator, bool>(iterator{tmp}, false);
+    }else if(left){
+
+      parent->left = n;
+      if(parent == leftmost){ leftmost = n; }		// new smallest key
+
+    }else{
+
+      parent->right = n;
+      if(parent == rightmost){ rightmost = n; }		// new largest key
     }
+
+    _insert_fixup(n, balancing_policy{});
   }
+
+  //============================= _INSERT ==============================
+  //
+  // A private auxiliary function that performs insertion of a new node
+  // in the tree, given its key and the arguments the node is constructed
+  // with (a key-value pair, or the pieces of one). The search only uses
+  // the key, so the pair is built directly inside the node and only if
+  // the key is not already present. It has been introduced to exploit
+  // forwarding reference, avoiding code duplication.
+  // A pair is returned with an iterator to the node with the given key
+  // and true if it has been inserted, false if it was already present.
   
-   // in case tree is empty create a node with the given key-value pair, set it as the root
-   // and return a pair iterator_to_the_node - true
+  template<typename K, typename... Types>
+  std::pair<iterator, bool> _insert(const K& x, Types&&... args){
+
+    node<pair_type>* parent;
+    bool left;
+
+    if(auto found = _descend(x, parent, left)){
+
+      return std::make_pair<iterator, bool>(iterator{found, &rightmost}, false);
+    }
 
-    root.reset(new node<pair_type>{nullptr, std::forward<O>(x)});
-    return std::make_pair<iterator, bool>(iterator{tmp}, true);
+    auto n = _create_node(parent, std::forward<Types>(args)...);
+    _grow(parent);
+    _link(n, parent, left);
+    return std::make_pair<iterator, bool>(iterator{n, &rightmost}, true);
   }
 
-  //============================= _BEGIN ===============================
+  //=========================== _INSERT_HINT ===========================
   //
-  // A private auxiliary function that finds the leftmost node, so the
-  // one with the smallest key and returns a raw pointer to it.
+  // A private auxiliary function that performs insertion next to the
+  // node hint refers to, when the key belongs there. The new node goes
+  // just before hint if the key is between the one of its predecessor
+  // and the one of hint, or just after it if the key is between the one
+  // of hint and the one of its successor; end() stands for a key greater
+  // than all the others. In the free place between two consecutive nodes
+  // (the right child of the first or the left child of the second) the
+  // node is linked without any search: only the neighbours of hint are
+  // compared, and reaching them is amortized O(1) when the hints follow
+  // the keys. If the hint is wrong a normal insertion is performed.
+  // The sizes of the ancestors of the new node still have to be updated.
+
+  template<typename K, typename... Types>
+  std::pair<iterator, bool> _insert_hint(const_iterator hint, const K& x, Types&&... args){
+
+    node<pair_type>* h{hint.current};
+    node<pair_type>* parent{nullptr};	// node the new one is linked to
+    bool left{false};			// whether it becomes its left child
+
+    if(!root){
+
+      return _insert(x, std::forward<Types>(args)...);
+
+    }else if(!h){				// end(): after the largest key
+
+      if(op(rightmost->pair.first, x)){ parent = rightmost; }
+
+    }else if(op(x, h->pair.first)){		// just before hint
+
+      const_iterator prev{hint};
 
-  node<pair_type>* _begin() const noexcept{
+      if(h == leftmost){
 
-    if(!root){ return nullptr; }  	// if the tree is empty (root = nullptr) we return nullptr
+        parent = h;
+        left = true;
 
-    auto tmp = root.get();        	
+      }else if(op((--prev)->first, x)){
 
-    while( tmp -> left ){         	// keep going to the left until a node that has no left
-                                  	// child is found and then return it
+        // either the predecessor has no right child or hint has no left one
+        if(prev.current->right){ parent = h; left = true; }
+        else{ parent = prev.current; }
+      }
+
+    }else if(op(h->pair.first, x)){		// just after hint
+
+      const_iterator next{hint};
+
+      if(h == rightmost){
+
+        parent = h;
+
+      }else if(op(x, (++next)->first)){
+
+        // either hint has no right child or the successor has no left one
+        if(h->right){ parent = next.current; left = true; }
+        else{ parent = h; }
+      }
 
-      tmp = tmp->left.get();
+    }else{					// the key is the one of hint
+
+      return std::make_pair<iterator, bool>(iterator{h, &rightmost}, false);
     }
 
-    return tmp;
+    if(!parent){ return _insert(x, std::forward<Types>(args)...); }
+
+    auto n = _create_node(parent, std::forward<Types>(args)...);
+    _grow(parent);
+    _link(n, parent, left);
+    return std::make_pair<iterator, bool>(iterator{n, &rightmost}, true);
+  }
+
+  //========================= _UPDATE_EXTREMA ===========================
+  //
+  // A private auxiliary function that finds the leftmost and the
+  // rightmost nodes, so the ones with the smallest and the largest key,
+  // and caches them. It is called after the whole tree has been replaced,
+  // while insert and erase keep them up to date in O(1).
+
+  void _update_extrema() noexcept{
+
+    leftmost = root;
+    rightmost = root;
+
+    if(!root){ return; }  		// if the tree is empty both are nullptr
+
+    while( leftmost -> left ){ leftmost = leftmost->left; }
+
+    while( rightmost -> right ){ rightmost = rightmost->right; }
   }
 
   //============================== _FIND ===============================
   //
   // A private auxiliary function that finds a node given its key and 
-  // returns a raw pointer to it.
+  // returns a raw pointer to it. The key may be of any type that the
+  // comparison operator can compare with key_type.
 
-  node<pair_type>* _find(const key_type& x) const noexcept{
+  template<typename K>
+  node<pair_type>* _find(const K& x) const noexcept{
 
-    auto tmp = root.get();
+    auto tmp = root;
 
     while(tmp){                         // until tmp is != nullptr
 
       if(op(x, tmp->pair.first)){       // if the searched key is smaller than the root key
 				        // according to the comparison type
 
-        tmp = tmp->left.get();		// go down on the left
+        tmp = tmp->left;		// go down on the left
 
       }else if(op(tmp->pair.first, x)){ // if the searched key is greater than the root key
       				        // according to the comparison type
 
-        tmp = tmp->right.get();		// go down on the right
+        tmp = tmp->right;		// go down on the right
 
       }else{				
     
@@ -171,82 +760,1140 @@ class bst{
     return nullptr;			// the tree is empty return end (which is nullptr)
   }
 
-  //========================== _SUB_BALANCE ============================
+  //====================== _LOWER_BOUND and _UPPER_BOUND ==================
   //
-  // A private auxiliary function that creates a balanced tree given the
-  // key-value pairs from a vector, starting from the middle value and
-  // recursively calling itself.
+  // Private auxiliary functions that return the first node whose key is
+  // not less than (_lower_bound) or greater than (_upper_bound) x, or
+  // nullptr if there is none. Going down the tree, every node that may be
+  // the answer is remembered before moving to its left subtree.
 
-  void _sub_balance( std::vector<pair_type> vec, int a, int b ){
+  template<typename K>
+  node<pair_type>* _lower_bound(const K& x) const noexcept{
 
-    // return condition to end recursive calls
-    if(b < a){ return; }
+    node<pair_type>* result{nullptr};
+    auto tmp = root;
 
-    int mid{(b+a)/2};			// find mid index
-  
-    insert(vec[mid]);			// insert the corresponding pair in the vector
+    while(tmp){
 
-    // recursively call the function for the two sub-vectors
+      if(op(tmp->pair.first, x)){ tmp = tmp->right; }
+      else{
 
-    _sub_balance(vec, a, mid-1);
-    _sub_balance(vec, mid+1, b);
-  
-    return;
+        result = tmp;
+        tmp = tmp->left;
+      }
+    }
+
+    return result;
   }
 
+  template<typename K>
+  node<pair_type>* _upper_bound(const K& x) const noexcept{
 
-  public:
-   
-  // ctor for an empty bst
+    node<pair_type>* result{nullptr};
+    auto tmp = root;
+
+    while(tmp){
+
+      if(op(x, tmp->pair.first)){
+
+        result = tmp;
+        tmp = tmp->left;
+
+      }else{ tmp = tmp->right; }
+    }
+
+    return result;
+  }
+
+  //============================== _RANK ================================
+  //
+  // A private auxiliary function that counts the keys less than x: going
+  // down the tree, every time we move to the right the node and its left
+  // subtree are counted.
+
+  template<typename K>
+  std::size_t _rank(const K& x) const{
+
+    std::size_t r{0};
+    auto tmp = root;
+
+    while(tmp){
+
+      if(op(tmp->pair.first, x)){
+
+        r += _size(tmp->left) + 1;
+        tmp = tmp->right;
+
+      }else{ tmp = tmp->left; }
+    }
+
+    return r;
+  }
+
+  //============================== _UNLINK ==============================
+  //
+  // A private auxiliary function that unlinks a node from the tree,
+  // re-arranging the tree in a such a way that all the constraints are
+  // respected, without destroying it. For a self-balancing tree the
+  // balance is then restored.
+
+  void _unlink(node<pair_type>* deleted_node) noexcept{
+
+    // update the cached extrema, moving them to the next/previous node
+    if(deleted_node == leftmost){ leftmost = (++iterator{deleted_node, &rightmost}).current; }
+    if(deleted_node == rightmost){ rightmost = (--iterator{deleted_node, &rightmost}).current; }
+
+    node<pair_type>* moved;		// node that takes the place of the unlinked one
+    node<pair_type>* moved_parent;	// its parent
+    bool unlinked_red;			// colour of the node unlinked from its place
+
+    if( deleted_node->left && deleted_node->right ){
+
+      // if the node has both children find its successor in terms of
+      // keys, which will not have a left child for sure, and move it in
+      // place of the deleted node; if the successor has a right child
+      // it takes the place of the successor
+
+      auto successor = deleted_node->right;
+
+      while(successor->left){ successor = successor->left; }
+
+      unlinked_red = successor->red;
+      moved = successor->right;
+
+      if( successor != deleted_node->right ){
+
+        // detach the successor, replacing it with its right child
+        moved_parent = successor->parent;
+        successor->parent->left = successor->right;
+
+        if(successor->right){ successor->right->parent = successor->parent; }
+
+        // the right subtree of the deleted node goes under the successor
+        successor->right = deleted_node->right;
+        successor->right->parent = successor;
+
+      }else{
+
+        moved_parent = successor;
+      }
+
+      // the left subtree of the deleted node goes under the successor
+      successor->left = deleted_node->left;
+      successor->left->parent = successor;
+
+      _replace(deleted_node, successor);
+      successor->red = deleted_node->red;	// the successor inherits the colour too
+      successor->size = deleted_node->size;	// and the size, fixed by _shrink below
+
+    }else{
+
+      // if the node has at most one child the child (or nullptr) takes
+      // its place
+
+      unlinked_red = deleted_node->red;
+      moved = deleted_node->left ? deleted_node->left : deleted_node->right;
+      moved_parent = deleted_node->parent;
+
+      _replace(deleted_node, moved);
+    }
+
+    _shrink(moved_parent);		// the path from the unlinked place up to the root
+
+    if(!unlinked_red){ _erase_fixup(moved, moved_parent, balancing_policy{}); }
+  } 
+
+  //============================== _ERASE ===============================
+  //
+  // A private auxiliary function that deletes a node, unlinking it and
+  // then giving it back to the allocator.
+
+  void _erase(node<pair_type>* deleted_node){
+
+    if(!deleted_node){ return;}					// the key is not present
+
+    _unlink(deleted_node);
+    _destroy_node(deleted_node);
+  }
+
+  //============================= _DETACH ==============================
+  //
+  // A private auxiliary function that unlinks a node which is no longer
+  // owned by the tree, leaving it ready to be linked again: without links
+  // and with the size and colour of a new node.
+
+  void _detach(node<pair_type>* n) noexcept{
+
+    _unlink(n);
+    --node_count;
+    _reset(n);
+  }
+
+  static void _reset(node<pair_type>* n) noexcept{
+
+    n->parent = nullptr;
+    n->left = nullptr;
+    n->right = nullptr;
+    n->size = 1;
+    n->red = false;
+  }
+
+  //============================= _EXTRACT =============================
+  //
+  // A private auxiliary function that detaches a node and hands it over
+  // to a node handle.
+
+  node_type _extract(node<pair_type>* n){
+
+    if(!n){ return node_type{}; }			// the key is not present
+
+    _detach(n);
+    return node_type{n, alloc};
+  }
+
+  //========================== SPLIT AND JOIN ===========================
+  //
+  // Private auxiliary functions working on detached subtrees (subtrees
+  // whose root has no parent), which split and join trees and, on top of
+  // that, compute unions, intersections and differences reusing the
+  // nodes. A detached subtree of a red-black tree always has a black root
+  // and comes with its black height (the number of black nodes on each
+  // path from the root down to a leaf), so that joining two of them costs
+  // O(1) plus the difference of their black heights; without balancing
+  // the black height is not used. The rotations of the red-black joins
+  // go through _replace, which treats root as the root of the subtree
+  // being joined: root is only meaningful again once the operation is
+  // over. The nodes are owned by this tree throughout.
+
+  struct _subtree{
+    node<pair_type>* top;		// root of the subtree, nullptr if empty
+    int bh;				// black height
+  };
+
+  static bool _black(const node<pair_type>* n) noexcept{ return !n || !n->red; }
+
+  // black height of a whole tree, counted along its left spine
+  static int _black_height(const node<pair_type>* n, red_black_balancing) noexcept{
+
+    int bh{0};
+    for(; n; n = n->left){ bh += _black(n); }
+    return bh;
+  }
+
+  static int _black_height(const node<pair_type>*, no_balancing) noexcept{ return 0; }
+
+  // detaches the child n of a node of black height bh from its parent;
+  // a red root is made black, increasing the black height
+  static _subtree _detached(node<pair_type>* n, int bh) noexcept{
+
+    if(n){
+
+      n->parent = nullptr;
+      if(n->red){ n->red = false; ++bh; }
+    }
+
+    return _subtree{n, bh};
+  }
+
+  // joins l, m and r, where all the keys of l are less than the key of m
+  // and all the ones of r greater: without balancing m becomes the root
+  _subtree _join(_subtree l, node<pair_type>* m, _subtree r, no_balancing) noexcept{
+
+    m->parent = nullptr;
+    m->left = l.top;
+    m->right = r.top;
+    if(l.top){ l.top->parent = m; }
+    if(r.top){ r.top->parent = m; }
+    m->size = _size(l.top) + _size(r.top) + 1;
+
+    return _subtree{m, 0};
+  }
+
+  // with red-black balancing, if the black heights are equal m becomes
+  // the (black) root; otherwise we go down the right spine of the higher
+  // tree l (the left spine of r) to the first black node c with the black
+  // height of the other tree, and m, coloured red, takes its place with c
+  // and the other tree as children, as if it had just been inserted
+  _subtree _join(_subtree l, node<pair_type>* m, _subtree r, red_black_balancing) noexcept{
+
+    if(l.bh == r.bh){
+
+      _join(l, m, r, no_balancing{});
+      m->red = false;
+      return _subtree{m, l.bh + 1};
+    }
+
+    bool right{l.bh > r.bh};			// spine the node goes down
+    _subtree high{right ? l : r};
+    _subtree low{right ? r : l};
+
+    node<pair_type>* c{high.top};
+    node<pair_type>* cp{nullptr};
+    int h{high.bh};
+
+    while(c && (c->red || h > low.bh)){
+
+      h -= _black(c);
+      cp = c;
+      c = right ? c->right : c->left;
+    }
+
+    m->parent = cp;
+    if(right){ cp->right = m; m->left = c; m->right = low.top; }
+    else{ cp->left = m; m->right = c; m->left = low.top; }
+    if(c){ c->parent = m; }
+    if(low.top){ low.top->parent = m; }
+    m->size = _size(c) + _size(low.top) + 1;
+
+    for(auto x = cp; x; x = x->parent){ x->size += _size(low.top) + 1; }
+
+    root = high.top;
+    _fix_red(m);
+
+    _subtree joined{root, high.bh};
+    if(root->red){ root->red = false; ++joined.bh; }	// the red went up to the root
+    return joined;
+  }
+
+  // goes up from the node up, reached from its left child if from_left,
+  // which is the root of a subtree of black height h split in l and r:
+  // each ancestor reached from its left goes, with its right subtree, to
+  // the right of r, and each ancestor reached from its right goes, with
+  // its left subtree, to the left of l. An ancestor is still untouched
+  // when reached, so the black height of its other child is h as well.
+  void _climb(node<pair_type>* up, bool from_left, _subtree& l, _subtree& r, int h) noexcept{
+
+    while(up){
+
+      node<pair_type>* next{up->parent};	// read before up is relinked
+      bool next_from_left{next && up == next->left};
+      int next_h{h + _black(up)};
+
+      if(from_left){ r = _join(r, up, _detached(up->right, h), balancing_policy{}); }
+      else{ l = _join(_detached(up->left, h), up, l, balancing_policy{}); }
+
+      up = next;
+      from_left = next_from_left;
+      h = next_h;
+    }
+  }
+
+  // splits the detached subtree holding the node m, of black height h,
+  // in l (the keys less than the one of m) and r (the greater ones),
+  // leaving m unlinked
+  void _split_at(node<pair_type>* m, int h, _subtree& l, _subtree& r) noexcept{
+
+    node<pair_type>* up{m->parent};
+    bool from_left{up && m == up->left};
+
+    l = _detached(m->left, h - _black(m));
+    r = _detached(m->right, h - _black(m));
+    _reset(m);
+
+    _climb(up, from_left, l, r, h);
+  }
+
+  // splits the detached subtree t in l (the keys less than x) and r (the
+  // greater ones); m is the unlinked node with key x, nullptr if there is
+  // none
+  template<typename K>
+  void _split(_subtree t, const K& x, _subtree& l, _subtree& r, node<pair_type>*& m){
+
+    node<pair_type>* n{t.top};
+    node<pair_type>* up{nullptr};
+    bool from_left{false};
+    int h{t.bh};
+
+    while(n){
+
+      if(op(x, n->pair.first)){ from_left = true; }
+      else if(op(n->pair.first, x)){ from_left = false; }
+      else{ break; }
+
+      up = n;
+      h -= _black(n);
+      n = from_left ? n->left : n->right;
+    }
+
+    m = n;
+    l = r = _subtree{nullptr, 0};
+
+    if(m){ _split_at(m, h, l, r); }
+    else{ _climb(up, from_left, l, r, h); }
+  }
+
+  // joins l and r, where all the keys of l are less than the ones of r,
+  // splitting the largest node off l to use it as the middle one
+  _subtree _join(_subtree l, _subtree r) noexcept{
+
+    if(!l.top){ return r; }
+    if(!r.top){ return l; }
+
+    node<pair_type>* m{l.top};
+    int h{l.bh};
+
+    while(m->right){ h -= _black(m); m = m->right; }
+
+    _subtree rest, none;			// none stays empty, m is the largest
+    _split_at(m, h, rest, none);
+    return _join(rest, m, r, balancing_policy{});
+  }
+
+  // union of a and b: b is split around the root of a, the two halves
+  // are merged with the subtrees of a, and the results are joined with
+  // the root of a; for a key present in both trees the node of a is kept
+  _subtree _union(_subtree a, _subtree b){
+
+    if(!a.top){ return b; }
+    if(!b.top){ return a; }
+
+    node<pair_type>* k{a.top};
+    int h{a.bh - _black(k)};
+    _subtree al{_detached(k->left, h)}, ar{_detached(k->right, h)};
+
+    _subtree bl, br;
+    node<pair_type>* m;
+    _split(b, k->pair.first, bl, br, m);
+
+    if(m){ _destroy_node(m); }
+
+    return _join(_union(al, bl), k, _union(ar, br), balancing_policy{});
+  }
+
+  // intersection of a and b, keeping the nodes of a
+  _subtree _intersection(_subtree a, _subtree b){
+
+    if(!a.top || !b.top){
+
+      _destroy(a.top, true);
+      _destroy(b.top, true);
+      return _subtree{nullptr, 0};
+    }
+
+    node<pair_type>* k{a.top};
+    int h{a.bh - _black(k)};
+    _subtree al{_detached(k->left, h)}, ar{_detached(k->right, h)};
+
+    _subtree bl, br;
+    node<pair_type>* m;
+    _split(b, k->pair.first, bl, br, m);
+
+    _subtree l{_intersection(al, bl)};
+    _subtree r{_intersection(ar, br)};
+
+    if(m){
+
+      _destroy_node(m);
+      return _join(l, k, r, balancing_policy{});
+    }
+
+    _destroy_node(k);
+    return _join(l, r);
+  }
+
+  // difference of a and b: a is split around the root of b
+  _subtree _difference(_subtree a, _subtree b){
+
+    if(!a.top || !b.top){
+
+      _destroy(b.top, true);
+      return a;
+    }
+
+    node<pair_type>* k{b.top};
+    int h{b.bh - _black(k)};
+    _subtree bl{_detached(k->left, h)}, br{_detached(k->right, h)};
+
+    _subtree al, ar;
+    node<pair_type>* m;
+    _split(a, k->pair.first, al, ar, m);
+
+    _destroy_node(k);
+    if(m){ _destroy_node(m); }
+
+    _subtree l{_difference(al, bl)};
+    return _join(l, _difference(ar, br));
+  }
+
+  // takes all the nodes out of the tree as a detached subtree, leaving
+  // the tree empty
+  _subtree _take() noexcept{
+
+    _subtree t{root, _black_height(root, balancing_policy{})};
+
+    root = nullptr;
+    leftmost = nullptr;
+    rightmost = nullptr;
+    node_count = 0;
+
+    return t;
+  }
+
+  // makes the detached subtree t the content of the (empty) tree
+  void _adopt(_subtree t) noexcept{
+
+    root = t.top;
+    node_count = _size(root);
+    _update_extrema();
+  }
+
+  // fills this empty tree with the pairs of x, moved in new nodes: they
+  // are already sorted, so _build_sorted makes a balanced tree in O(n);
+  // x is left empty
+  void _move_in(bst& x){
+
+    auto it = std::make_move_iterator(x.begin());
+
+    root = _build_sorted(it, x.node_count);
+    _update_extrema();
+    _recolour(balancing_policy{});
+
+    x.clear();
+  }
+
+  // nodes can only move to a tree with an equal allocator: this returns
+  // a tree with the allocator of this one and the pairs of x, moved in new
+  // nodes as done by the move assignment when the allocators differ
+  bst _rehome(bst& x) const{
+
+    bst moved{x.op, allocator_type(alloc)};
+
+    moved._move_in(x);
+    return moved;
+  }
+
+  // performs the set operation f on the nodes of a and b, leaving the
+  // result in a
+  static void _set_operation(bst& a, bst& b, _subtree (bst::*f)(_subtree, _subtree)){
+
+    if(!(a.alloc == b.alloc)){
+
+      bst moved{a._rehome(b)};
+      _set_operation(a, moved, f);
+      return;
+    }
+
+    std::size_t count{a.node_count + b.node_count};
+    _subtree ta{a._take()}, tb{b._take()};
+
+    a.node_count = count;			// the destroyed nodes are subtracted
+    a._adopt((a.*f)(ta, tb));
+  }
+
+  //=========================== _FIND_MANY =============================
+  //
+  // A private auxiliary function that looks for the keys of a range in
+  // groups of batch_size searches going down the tree in lockstep: at
+  // each round every search still running compares its key with its
+  // current node and moves to a child, which is prefetched, so that the
+  // cache misses of the searches of a group overlap instead of following
+  // one another. For each key an iterator of type It is written to out.
+  // The keys of a group are read through their addresses only when the
+  // range is a forward one whose elements are lvalues, which stay valid
+  // after ++first; otherwise (input iterators, iterators returning
+  // prvalues) they are copied into the group.
+
+  static constexpr std::size_t batch_size{16};
+
+  template<typename It, typename I, typename O>
+  O _find_many(I first, I last, O out) const{
+
+    using traits = std::iterator_traits<I>;
+    using search_key = typename traits::value_type;
+
+    constexpr bool by_address{std::is_base_of<std::forward_iterator_tag, typename traits::iterator_category>::value
+                              && std::is_lvalue_reference<typename traits::reference>::value};
+
+    using key_slot = typename std::conditional<by_address, const search_key*, search_key>::type;
+
+    key_slot keys[batch_size];			// keys of the group
+    node<pair_type>* current[batch_size];	// node each search has reached
+    node<pair_type>* found[batch_size];		// result of each search
+    std::size_t running[batch_size];		// searches not finished yet
+
+    while(first != last){
+
+      std::size_t count{0};
+
+      for(; count < batch_size && first != last; ++count, ++first){
+
+        if constexpr(by_address){ keys[count] = std::addressof(*first); }
+        else{ keys[count] = *first; }
+        current[count] = root;
+        found[count] = nullptr;
+        running[count] = count;
+      }
+
+      std::size_t n_running{root ? count : 0};
+
+      while(n_running){
+
+        for(std::size_t k{0}; k < n_running; ){
+
+          std::size_t j{running[k]};
+          auto tmp = current[j];
+          const search_key* key;
+
+          if constexpr(by_address){ key = keys[j]; }
+          else{ key = &keys[j]; }
+
+          if(op(*key, tmp->pair.first)){
+
+            tmp = tmp->left;
+
+          }else if(op(tmp->pair.first, *key)){
+
+            tmp = tmp->right;
+
+          }else{
+
+            found[j] = tmp;
+            tmp = nullptr;
+          }
+
+          if(tmp){				// the search goes on from tmp
+
+#if defined(__GNUC__)
+            __builtin_prefetch(tmp);
+#endif
+            current[j] = tmp;
+            ++k;
+
+          }else{				// the search is over
+
+            running[k] = running[--n_running];
+          }
+        }
+      }
+
+      for(std::size_t j{0}; j < count; ++j){ *out++ = It{found[j], &rightmost}; }
+    }
+
+    return out;
+  }
+
+  //========================== _TREE_TO_VINE ============================
+  //
+  // A private auxiliary function that turns the tree into a "vine", i.e.
+  // a list of nodes linked through their right child, sorted by key.
+  // Going down the right spine, each node with a left child is rotated
+  // to the right until it has none; every rotation moves one node on the
+  // spine, so at most n rotations are performed.
+
+  void _tree_to_vine() noexcept{
+
+    auto tmp = root;
+
+    while(tmp){
+
+      if(tmp->left){
+
+        _rotate_right(tmp);		// the left child goes up in place of tmp
+        tmp = tmp->parent;
+
+      }else{
+
+        tmp = tmp->right;		// go down along the vine
+      }
+    }
+  }
+
+  //============================ _COMPRESS ==============================
+  //
+  // A private auxiliary function that performs count left rotations along
+  // the right spine, starting from the root and rotating every other
+  // node, halving the length of the spine.
+
+  void _compress(std::size_t count) noexcept{
+
+    auto tmp = root;
+
+    for(std::size_t i{0}; i < count; ++i){
+
+      _rotate_left(tmp);		// the right child goes up in place of tmp
+      tmp = tmp->parent->right;		// skip it and move to the next one
+    }
+  }
+
+  //========================== _VINE_TO_TREE ============================
+  //
+  // A private auxiliary function that turns a vine of n nodes into a
+  // balanced tree: first the nodes exceeding the largest complete tree
+  // that fits in n are moved to the bottom level, then the spine is
+  // compressed repeatedly. All the levels are full except the last one.
+
+  void _vine_to_tree(std::size_t n) noexcept{
+
+    std::size_t m{1};
+
+    while(m <= n+1){ m *= 2; }		// m = size of the largest complete tree + 1
+
+    m = m/2 - 1;
+
+    _compress(n - m);
+
+    while(m > 1){
+
+      m /= 2;
+      _compress(m);
+    }
+  }
+
+  //============================ _RECOLOUR ==============================
+  //
+  // A private auxiliary function that colours a tree whose levels are all
+  // full except the last one, after it has been reshaped. Without
+  // balancing nothing has to be done; for a red-black tree the nodes on
+  // the last level are red and all the others are black, so that every
+  // path from the root has the same number of black nodes. The tree is
+  // visited in order through the parent links, keeping track of the depth.
+
+  void _recolour(no_balancing) noexcept{}
+
+  void _recolour(red_black_balancing) noexcept{
+
+    if(!root){ return; }
+
+    std::size_t last{0};		// depth of the last level
+
+    for(std::size_t m{node_count}; m > 1; m /= 2){ ++last; }
+
+    auto tmp = root;
+    std::size_t depth{0};
+
+    while(tmp->left){ tmp = tmp->left; ++depth; }
+
+    while(tmp){
+
+      tmp->red = (depth == last && depth > 0);
+
+      if(tmp->right){			// go to the leftmost node of the right subtree
+
+        tmp = tmp->right;
+        ++depth;
+
+        while(tmp->left){ tmp = tmp->left; ++depth; }
+
+      }else{				// go up until we come from a left child
+
+        while(tmp->parent && tmp == tmp->parent->right){ tmp = tmp->parent; --depth; }
+
+        tmp = tmp->parent;
+        --depth;
+      }
+    }
+  }
+
+
+  //========================== _BUILD_SORTED ============================
+  //
+  // A private auxiliary function that builds a balanced tree out of the
+  // next n pairs of a sorted sequence, returning its root. The pairs are
+  // consumed in order: first the left subtree is built out of the first
+  // (n-1)/2 pairs, then the root out of the next one and finally the
+  // right subtree out of the remaining ones, so each pair is read once
+  // and the nodes are allocated one after the other. All the levels of
+  // the tree are full except the last one and the recursion depth is
+  // O(log n).
+
+  template<typename I>
+  node<pair_type>* _build_sorted(I& it, std::size_t n){
+
+    if(n == 0){ return nullptr; }
+
+    std::size_t n_left{(n-1)/2};
+
+    auto left = _build_sorted(it, n_left);
+    node<pair_type>* tmp;
+
+    try{
+      tmp = _create_node(nullptr, *it);
+      ++it;
+
+    }catch(...){
+
+      _destroy(left, true);		// do not leak the left subtree
+      throw;
+    }
+
+    tmp->left = left;
+    if(left){ left->parent = tmp; }
+
+    try{
+      tmp->right = _build_sorted(it, n - n_left - 1);
+
+    }catch(...){
+
+      _destroy(tmp, true);		// do not leak the node and its left subtree
+      throw;
+    }
+
+    if(tmp->right){ tmp->right->parent = tmp; }
+
+    tmp->size = n;
+
+    return tmp;
+  }
+
+  //========================== _BUILD_PARALLEL ==========================
+  //
+  // Private auxiliary functions that build the tree out of the pairs
+  // pointed to by sorted, with the same shape as _build_sorted, using up
+  // to `threads` threads. _plan follows the recursion of _build_sorted
+  // down to the level with at least one subtree per thread, collecting
+  // in order the positions of the pairs of the nodes above it and the
+  // ranges of the subtrees below it. The top nodes are allocated first,
+  // then every subtree is built by a thread in a tree of its own, whose
+  // node count is not shared with the others, and finally _stitch links
+  // the subtrees to the top nodes, which cannot fail. Nodes are allocated
+  // concurrently only if all the allocators of their type are equal, and
+  // so stateless; otherwise, e.g. with a pool, the tree is built by the
+  // calling thread alone.
+
+  static void _plan(std::size_t first, std::size_t n, std::size_t depth, std::vector<std::size_t>& tops,
+		    std::vector<std::pair<std::size_t, std::size_t>>& ranges){
+
+    if(n == 0){ return; }
+
+    if(depth == 0){ ranges.emplace_back(first, n); return; }
+
+    std::size_t n_left{(n-1)/2};
+
+    _plan(first, n_left, depth - 1, tops, ranges);
+    tops.push_back(first + n_left);
+    _plan(first + n_left + 1, n - n_left - 1, depth - 1, tops, ranges);
+  }
+
+  static node<pair_type>* _stitch(std::size_t n, std::size_t depth, node<pair_type>* const*& top,
+				  node<pair_type>* const*& sub) noexcept{
+
+    if(n == 0){ return nullptr; }
+
+    if(depth == 0){ return *sub++; }
+
+    std::size_t n_left{(n-1)/2};
+
+    auto left = _stitch(n_left, depth - 1, top, sub);
+    auto tmp = *top++;
+    auto right = _stitch(n - n_left - 1, depth - 1, top, sub);
+
+    tmp->left = left;
+    if(left){ left->parent = tmp; }
+
+    tmp->right = right;
+    if(right){ right->parent = tmp; }
+
+    tmp->size = n;
+
+    return tmp;
+  }
+
+  void _build_parallel(const std::vector<pair_type*>& sorted, std::size_t threads){
+
+    const std::size_t n{sorted.size()};
+    std::size_t depth{0};		// levels above the subtrees built by the threads
+
+    if(node_traits::is_always_equal::value && n / threads >= _parallel_grain){
+
+      while((std::size_t{1} << depth) < threads){ ++depth; }
+    }
+
+    if(depth == 0){
+
+      _moving_deref<pair_type> it{sorted.data()};
+      root = _build_sorted(it, n);
+      return;
+    }
+
+    std::vector<std::size_t> tops;
+    std::vector<std::pair<std::size_t, std::size_t>> ranges;
+
+    _plan(0, n, depth, tops, ranges);
+
+    std::vector<node<pair_type>*> top_nodes;
+    std::vector<node<pair_type>*> subtrees(ranges.size(), nullptr);
+
+    try{
+      top_nodes.reserve(tops.size());
+
+      for(auto i : tops){ top_nodes.push_back(_create_node(nullptr, std::move(*sorted[i]))); }
+
+      _parallel_run(threads, ranges.size(), [&](std::size_t t){
+
+	bst part{op, allocator_type(alloc)};
+	_moving_deref<pair_type> it{sorted.data() + ranges[t].first};
+
+	subtrees[t] = part._build_sorted(it, ranges[t].second);
+      });
+
+    }catch(...){
+
+      for(auto x : top_nodes){ _destroy_node(x); }
+
+      for(auto x : subtrees){
+
+	if(x){ node_count += _size(x); _destroy(x, true); }
+      }
+
+      throw;
+    }
+
+    node_count += n - tops.size();
+
+    node<pair_type>* const* top{top_nodes.data()};
+    node<pair_type>* const* sub{subtrees.data()};
+
+    root = _stitch(n, depth, top, sub);
+  }
+
+  //======================= _HEADER and _READER =========================
+  //
+  // Private auxiliaries of save() and load(). _header describes the file:
+  // a magic string, the version of the format, the record sizes and the
+  // tags of keys and values given by their serializers and the number of
+  // pairs. _reader gives the pairs of a stream one after the other,
+  // reading one each time it is dereferenced, which _build_sorted does
+  // once per pair; raw keys and values are read in blocks of _block bytes
+  // and copied out.
+
+  struct _header{
+
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t key_size;
+    std::uint32_t value_size;
+    std::uint32_t key_tag;
+    std::uint32_t value_tag;
+    std::uint64_t count;
+  };
+
+  static constexpr std::uint32_t _version{2};
+
+  static constexpr bool _raw{_raw_serializer<key_type>::value && _raw_serializer<value_type>::value};
+
+  static constexpr std::size_t _record{sizeof(key_type) + sizeof(value_type)};	// size of a raw pair
+
+  static constexpr std::size_t _block{64*1024};
+
+  struct _reader{
+
+    std::istream& is;
+    std::uint64_t left;			// pairs still to be read
+    std::vector<char> buf;		// block of raw pairs
+    std::size_t pos;			// next raw pair in buf
+
+    pair_type operator*(){
+
+      if constexpr(_raw){
+
+	if(pos == buf.size()){
+
+	  std::size_t pairs{std::min<std::uint64_t>(left, _block / _record + 1)};
+
+	  buf.resize(pairs * _record);
+	  is.read(buf.data(), buf.size());
+	  pos = 0;
+	}
+
+	if(!is){ throw std::runtime_error{"bst::load: unexpected end of the data"}; }
+
+	key_type k;
+	value_type v;
+
+	std::memcpy(&k, buf.data() + pos, sizeof(key_type));
+	std::memcpy(&v, buf.data() + pos + sizeof(key_type), sizeof(value_type));
+	pos += _record;
+	--left;
+
+	return pair_type{std::move(k), std::move(v)};
+
+      }else{
+
+	key_type k{serializer<key_type>::read(is)};
+	value_type v{serializer<value_type>::read(is)};
+
+	if(!is){ throw std::runtime_error{"bst::load: unexpected end of the data"}; }
+
+	--left;
+
+	return pair_type{std::move(k), std::move(v)};
+      }
+    }
+
+    _reader& operator++() noexcept{ return *this; }
+  };
+
+  //=========================== _CHUNK_COUNT ============================
+  //
+  // A private auxiliary function that returns in how many chunks of
+  // consecutive pairs the tree is split by the parallel visits: one every
+  // _parallel_grain pairs, up to 1024, and none for an empty tree.
+
+  std::size_t _chunk_count() const noexcept{
+
+    return std::min<std::size_t>(1024, (node_count + _parallel_grain - 1) / _parallel_grain);
+  }
+
+  //=========================== _ASSIGN_RANGE ===========================
+  //
+  // Private auxiliary functions that fill an empty tree with the pairs of
+  // a range. If the keys of a range of forward iterators turn out to be
+  // strictly increasing the tree is built directly in O(n), otherwise
+  // the pairs are inserted one by one and the tree is balanced at the
+  // end. A range of input iterators can be read only once, so it is
+  // first copied in a vector.
+
+  template<typename I>
+  void _assign_range(I first, I last, std::forward_iterator_tag){
+
+    auto prev = first;
+    auto tmp = first;
+    bool sorted{true};
+
+    if(tmp != last){
+
+      for(++tmp; tmp != last; ++tmp, ++prev){
+
+        if(!op((*prev).first, (*tmp).first)){ sorted = false; break; }
+      }
+    }
+
+    if(sorted){
+
+      root = _build_sorted(first, std::distance(first, last));
+      _update_extrema();
+      _recolour(balancing_policy{});
+
+    }else{
+
+      for(; first != last; ++first){ insert(*first); }
+
+      balance();
+    }
+  }
+
+  template<typename I>
+  void _assign_range(I first, I last, std::input_iterator_tag){
+
+    std::vector<typename std::iterator_traits<I>::value_type> tmp(first, last);
+
+    _assign_range(tmp.begin(), tmp.end(), std::forward_iterator_tag{});
+  }
+
+
+  public:
+   
+  // ctor for an empty bst
+
+  bst(): op{}, alloc{}, root{nullptr}, leftmost{nullptr}, rightmost{nullptr}, node_count{0} {}
+
+  // ctor for an empty bst specifying the comparison operator
+
+  explicit bst(comparison_type comp): op{comp}, alloc{}, root{nullptr}, leftmost{nullptr}, rightmost{nullptr}, node_count{0} {}
+
+  // ctor for an empty bst specifying the allocator
+
+  explicit bst(const allocator_type& a): op{}, alloc{a}, root{nullptr}, leftmost{nullptr}, rightmost{nullptr}, node_count{0} {}
+
+  // ctor for an empty bst specifying the comparison operator and the allocator
+
+  bst(comparison_type comp, const allocator_type& a): op{comp}, alloc{a}, root{nullptr}, leftmost{nullptr}, rightmost{nullptr}, node_count{0} {}
+
+  // RANGE CONSTRUCTOR:
+  // Builds a balanced tree out of the pairs of the range [first, last).
+  // As for insert, if a key appears more than once only the first pair
+  // is kept. Sorted ranges are detected and built in O(n).
+
+  template<typename I, typename = typename std::iterator_traits<I>::iterator_category>
+  bst(I first, I last, comparison_type comp = comparison_type{}, const allocator_type& a = allocator_type{}):
+    op{comp}, alloc{a}, root{nullptr}, leftmost{nullptr}, rightmost{nullptr}, node_count{0} {
+
+    try{
+      _assign_range(first, last, typename std::iterator_traits<I>::iterator_category{});
+
+    }catch(...){
+
+      clear();
+      throw;
+    }
+  }
+
+  // SORTED RANGE CONSTRUCTOR:
+  // Builds a balanced tree out of the pairs of the range [first, last) of
+  // forward iterators, which must be sorted by key without duplicates.
+  // The pairs are read once, in order, and the tree is built in O(n)
+  // without any comparison.
+
+  template<typename I>
+  bst(sorted_unique_t, I first, I last, comparison_type comp = comparison_type{}, const allocator_type& a = allocator_type{}):
+    op{comp}, alloc{a}, root{nullptr}, leftmost{nullptr}, rightmost{nullptr}, node_count{0} {
+
+    root = _build_sorted(first, std::distance(first, last));
+    _update_extrema();
+    _recolour(balancing_policy{});
+  }
+
+  // PARALLEL RANGE CONSTRUCTOR:
+  // Builds a balanced tree out of the pairs of the range [first, last),
+  // in any order, using up to `threads` threads (0 for one per hardware
+  // thread). As for the range constructor only the first pair with a
+  // given key is kept, and the tree does not depend on the number of
+  // threads. The pairs are copied, then sorted and deduplicated by the
+  // threads, which finally build disjoint subtrees concurrently.
+
+  template<typename I>
+  bst(parallel_build_t, I first, I last, std::size_t threads = 0, comparison_type comp = comparison_type{},
+      const allocator_type& a = allocator_type{}):
+    op{comp}, alloc{a}, root{nullptr}, leftmost{nullptr}, rightmost{nullptr}, node_count{0} {
+
+    threads = _thread_count(threads);
 
-  bst() noexcept: op{}, root{nullptr} {}
+    std::vector<pair_type> pairs(first, last);
 
-  // ctor for an empty bst specifying the comparison operator
+    _build_parallel(_parallel_sort_unique(pairs, op, threads), threads);
+    _update_extrema();
+    _recolour(balancing_policy{});
+  }
 
-  explicit bst(comparison_type comp) noexcept: op{comp}, root{nullptr} {}
+  // dtor, all the nodes are given back to the allocator
+
+  ~bst() noexcept{ clear(); }
   
   
   //========================== COPY SEMANTICS ============================
   
   // COPY CONSTRUCTOR:
   // Given a binary search tree it performs a deep copy of it, creating a
-  // new binary search tree.
-
-  explicit bst(const bst& x): op{x.op}, root{std::unique_ptr<node<pair_type>>(new node<pair_type>(nullptr, x.root.get()->pair))} {
+  // new binary search tree with the same shape, in O(n) time (see _clone).
 
-    if( x.root.get()->left ){    	// if the root of the copied tree has a left child, it has to be copied
-   
-      _copy(x.root.get() -> left);      // call to the private function _copy to copy the left subtree
-    }
+  explicit bst(const bst& x):
+    op{x.op}, alloc{node_traits::select_on_container_copy_construction(x.alloc)}, root{nullptr}, leftmost{nullptr}, rightmost{nullptr}, node_count{0} {
 
-    if( x.root.get()->right ){		// if the root of the copied tree has a right child, it has to be copied
-
-      _copy(x.root.get() -> right);	// call to the private function _copy to copy the right subtree
-    } 
+    root = _clone(x.root);
+    _update_extrema();
   }
 
   // COPY ASSIGNMENT:
   // Given a binary search tree it performs a deep copy of it, creating a
-  // new binary search tree.
+  // new binary search tree with the same shape, in O(n) time (see _clone).
   
   bst& operator=(const bst& x){
 
+    if(this == &x){ return *this; }	// self-assignment
+
     this->clear();			// clear the new tree
-    
-    this->insert(x.root.get()->pair);	// create the root of the new tree with key-value pair equal to the
-					// root of the copied tree
-    
-    if( x.root.get() -> left){		// if the copied tree has a left child
-      
-      _copy(x.root.get() -> left);	// call to the private function _copy to copy the left subtree
+
+    if( node_traits::propagate_on_container_copy_assignment::value ){
+
+      alloc = x.alloc;			// the allocator goes along with the content if requested
     }
-    
-    if( x.root.get() -> right){		// if the copied tree has a right child
-      
-      _copy(x.root.get() -> right);	// call to the private function _copy to copy the right subtree
-   } 
 
-   return *this;			// return the new tree
+    op = x.op;
+
+    root = _clone(x.root);
+    _update_extrema();
+
+    return *this;			// return the new tree
   }
 
 
@@ -254,38 +1901,50 @@ class bst{
   
   // MOVE CONSTRUCTOR
   // Given a binary search tree it moves it, creating a new binary search 
-  // tree.
-
-  bst(bst&&) = default;			// compiler generated is ok
-
-  // manual implementation
-  //
-  // bst(bst&& x): op{std::move(x.op)}, root{std::move(x.root)}{
-  //        
-  //   x.root.reset(nullptr);
-  //
-  // }
+  // tree. The nodes are not owned by smart pointers, so the moved-from
+  // tree has to be emptied by hand.
+
+  bst(bst&& x) noexcept:
+    op{std::move(x.op)}, alloc{x.alloc}, root{x.root}, leftmost{x.leftmost}, rightmost{x.rightmost}, node_count{x.node_count} {
+         
+    x.root = nullptr;
+    x.leftmost = nullptr;
+    x.rightmost = nullptr;
+    x.node_count = 0;
+  }
 
   // MOVE ASSIGNMENT
   // Given a binary search tree it moves it, creating a new binary search 
-  // tree.
+  // tree. If the allocator does not follow the content and the two
+  // allocators differ the nodes cannot be stolen, so the pairs, already
+  // sorted, are moved in new nodes making up a balanced tree, in O(n).
 
-  bst& operator=(bst&&) = default;	// compiler generated is ok
-  
-  // manual implementation
-  //
-  // bst& operator=(bst&& x){
-  //
-  //  op = std::move(x.op);
-  //  
-  //  root = std::move(x.root);
-  //   
-  //  x.root.reset(nullptr);
-  //
-  //  std::cout << "move assignment" << std::endl;
-  //
-  //  return *this;
-  // }
+  bst& operator=(bst&& x){
+
+    this->clear();
+
+    op = std::move(x.op);
+
+    if( node_traits::propagate_on_container_move_assignment::value || alloc == x.alloc ){
+
+      if( node_traits::propagate_on_container_move_assignment::value ){ alloc = x.alloc; }
+
+      root = x.root;
+      leftmost = x.leftmost;
+      rightmost = x.rightmost;
+      node_count = x.node_count;
+      x.root = nullptr;
+      x.leftmost = nullptr;
+      x.rightmost = nullptr;
+      x.node_count = 0;
+
+    }else{
+
+      _move_in(x);
+    }
+
+    return *this;
+  }
 
 
   //============================= INSERT ===============================
@@ -301,10 +1960,10 @@ class bst{
   // set to false.
 
   // l-value
-  std::pair<iterator, bool> insert(const pair_type& x){ return _insert(x); }
+  std::pair<iterator, bool> insert(const pair_type& x){ return _insert(x.first, x); }
   
   // r-value
-  std::pair<iterator, bool> insert(pair_type&& x){ return _insert(std::move(x)); }
+  std::pair<iterator, bool> insert(pair_type&& x){ return _insert(x.first, std::move(x)); }
 
   
   //============================= EMPLACE ==============================
@@ -327,53 +1986,195 @@ class bst{
   }
 
 
+  //========================== INSERT NODE ============================
+  //
+  // Links in the tree the node owned by the given handle, if its key is
+  // not already present. Nothing is allocated or copied, unless the
+  // handle comes from a tree with a different allocator: its node cannot
+  // be linked here, so its pair is moved in a new node and the handle
+  // gives the old one back to its allocator. The returned structure
+  // holds an iterator to the node with the key, whether the pair has
+  // been inserted and, if it has not, the handle, which still owns it.
+
+  insert_return_type insert(node_type&& nh){
+
+    if(nh.empty()){ return insert_return_type{end(), false, node_type{}}; }
+
+    if(!(*nh.alloc == alloc)){
+
+      auto result = _insert(nh.ptr->pair.first, std::move(nh.ptr->pair));
+
+      if(!result.second){ return insert_return_type{result.first, false, std::move(nh)}; }
+
+      nh._destroy();
+      return insert_return_type{result.first, true, node_type{}};
+    }
+
+    node<pair_type>* parent;
+    bool left;
+
+    if(auto found = _descend(nh.ptr->pair.first, parent, left)){
+
+      return insert_return_type{iterator{found, &rightmost}, false, std::move(nh)};
+    }
+
+    node<pair_type>* n{nh._release()};
+    _grow(parent);
+    _link(n, parent, left);
+    ++node_count;
+    return insert_return_type{iterator{n, &rightmost}, true, node_type{}};
+  }
+
+
+  //========================= HINTED INSERTION =========================
+  //
+  // Insert and emplace with, as first argument, an iterator to the node
+  // the new one should be placed next to (end() to append after the
+  // largest key). When the hint is right the node is linked without
+  // descending the tree, which makes building a tree out of increasing
+  // or nearly increasing keys much cheaper; when it is wrong the pair
+  // is inserted as usual. An iterator to the node with the given key is
+  // returned, whether it has been inserted or it was already present.
+
+  // l-value
+  iterator insert(const_iterator hint, const pair_type& x){ return _insert_hint(hint, x.first, x).first; }
+
+  // r-value
+  iterator insert(const_iterator hint, pair_type&& x){ return _insert_hint(hint, x.first, std::move(x)).first; }
+
+  template< class... Types >
+  iterator emplace_hint(const_iterator hint, Types&&... args){
+
+    pair_type x{std::forward<Types>(args)...};
+    return _insert_hint(hint, x.first, std::move(x)).first;
+  }
+
+
+  //=========================== TRY EMPLACE ============================
+  //
+  // Looks for the given key and, only if it is not present, inserts a
+  // node whose pair is constructed in place from the key and from the
+  // given arguments of the value constructor, so that no temporary pair
+  // is built and moved. If the key is present nothing is constructed and
+  // the arguments are left untouched. The returned pair is the same as
+  // for insert.
+
+  // l-value
+  template<typename... Types>
+  std::pair<iterator, bool> try_emplace(const key_type& k, Types&&... args){
+
+    return _insert(k, std::piecewise_construct, std::forward_as_tuple(k),
+                   std::forward_as_tuple(std::forward<Types>(args)...));
+  }
+
+  // r-value
+  template<typename... Types>
+  std::pair<iterator, bool> try_emplace(key_type&& k, Types&&... args){
+
+    return _insert(k, std::piecewise_construct, std::forward_as_tuple(std::move(k)),
+                   std::forward_as_tuple(std::forward<Types>(args)...));
+  }
+
+
+  //======================== INSERT OR ASSIGN ==========================
+  //
+  // Like try_emplace, with the value constructed from v, but when the key
+  // is already present v is assigned to its value. Either way the tree is
+  // descended once; the boolean is true if a node has been inserted.
+
+  // l-value
+  template<typename M>
+  std::pair<iterator, bool> insert_or_assign(const key_type& k, M&& v){
+
+    auto r = try_emplace(k, std::forward<M>(v));	// v is only used on a miss
+    if(!r.second){ r.first->second = std::forward<M>(v); }
+    return r;
+  }
+
+  // r-value
+  template<typename M>
+  std::pair<iterator, bool> insert_or_assign(key_type&& k, M&& v){
+
+    auto r = try_emplace(std::move(k), std::forward<M>(v));
+    if(!r.second){ r.first->second = std::forward<M>(v); }
+    return r;
+  }
+
+
   // ============================= CLEAR ================================
   // 
   // Clears the content of the tree.
-  // The reset function of std::unique_ptr destroys the object currently 
-  // managed by the unique ptr and takes ownership, if called  with 
-  // nullptr the unique_ptr becomes empty, so by applying release(nullptr) 
-  // to the root the destructor of the root gets called and all its 
-  // elements are destroyed, including the pointers to the other nodes, 
-  // triggering the cascade destruction of the whole tree.
+  // All the nodes are destroyed and their memory is given back to the
+  // allocator; with an allocator able to release all its memory at once
+  // (e.g. pool_allocator) the nodes are only destroyed and then the whole
+  // pool is freed in a single step.
 
   void clear() noexcept{
-    root.reset();
+
+    _free_all(is_releasing_allocator<node_allocator>{});
+    root = nullptr;
+    leftmost = nullptr;
+    rightmost = nullptr;
   }
 
 
+  // ========================== GET_ALLOCATOR ===========================
+  //
+  // Returns a copy of the allocator used by the tree.
+
+  allocator_type get_allocator() const{ return allocator_type{alloc}; }
+
+
   // ============================= BEGIN ================================
   // 
-  // Finds the leftmost node of the tree and returns an iterator to it.
-  // It has been implemented through a private function _begin that
-  // finds the leftmost node and returns its pointer, from which the
-  // proper operator is built.
+  // Returns an iterator to the leftmost node of the tree, which is cached
+  // inside the tree, in O(1).
 
-  iterator begin() noexcept{ return iterator{_begin()}; }
-  const_iterator begin() const noexcept{ return const_iterator{_begin()}; }
+  iterator begin() noexcept{ return iterator{leftmost, &rightmost}; }
+  const_iterator begin() const noexcept{ return const_iterator{leftmost, &rightmost}; }
 
 
   // ============================= CBEGIN ===============================
   //
   // Constant version of begin, returning a constant iterator.
 
-  const_iterator cbegin() const noexcept{ return const_iterator{_begin()}; }
+  const_iterator cbegin() const noexcept{ return const_iterator{leftmost, &rightmost}; }
 
 
   // ============================== END =================================
   // 
   // Returns an iterator to one past the last element (in terms of keys)
-  // of the tree, so a pointer to nullptr.
+  // of the tree, so a pointer to nullptr. Decrementing it leads to the
+  // rightmost node.
 
-  iterator end() noexcept { return iterator{nullptr}; }
-  const_iterator end() const noexcept{ return const_iterator{nullptr}; }
+  iterator end() noexcept { return iterator{nullptr, &rightmost}; }
+  const_iterator end() const noexcept{ return const_iterator{nullptr, &rightmost}; }
 
 
-  // ============================= CBEGIN ===============================
+  // ============================== CEND ================================
   //
   // Constant version of end, returning a constant iterator.
 
-  const_iterator cend() const noexcept{ return const_iterator{nullptr}; }
+  const_iterator cend() const noexcept{ return const_iterator{nullptr, &rightmost}; }
+
+
+  // ============================= RBEGIN ===============================
+  //
+  // Returns a reverse iterator to the rightmost node of the tree, from
+  // which the tree is traversed from the largest to the smallest key.
+
+  reverse_iterator rbegin() noexcept{ return reverse_iterator{end()}; }
+  const_reverse_iterator rbegin() const noexcept{ return const_reverse_iterator{end()}; }
+  const_reverse_iterator crbegin() const noexcept{ return const_reverse_iterator{end()}; }
+
+
+  // ============================== REND ================================
+  //
+  // Returns a reverse iterator to one before the leftmost node.
+
+  reverse_iterator rend() noexcept{ return reverse_iterator{begin()}; }
+  const_reverse_iterator rend() const noexcept{ return const_reverse_iterator{begin()}; }
+  const_reverse_iterator crend() const noexcept{ return const_reverse_iterator{begin()}; }
 
 
   // ============================== FIND ================================
@@ -384,49 +2185,263 @@ class bst{
   // It has been implemented through a private function _find() that
   // looks for the key inside the tree.
 
-  iterator find(const key_type& x){ return iterator{_find(x)}; }
-  const_iterator find(const key_type& x) const{ return const_iterator{_find(x)}; }
+  iterator find(const key_type& x){ return iterator{_find(x), &rightmost}; }
+  const_iterator find(const key_type& x) const{ return const_iterator{_find(x), &rightmost}; }
+
+  // With a transparent comparison operator (one declaring is_transparent,
+  // such as std::less<>) any type comparable with the keys can be looked
+  // for, without building a temporary key_type (e.g. a std::string out of
+  // a const char*).
+
+  template<typename K, typename C = comparison_type, typename = typename C::is_transparent>
+  iterator find(const K& x){ return iterator{_find(x), &rightmost}; }
+
+  template<typename K, typename C = comparison_type, typename = typename C::is_transparent>
+  const_iterator find(const K& x) const{ return const_iterator{_find(x), &rightmost}; }
+
+
+  // ============================== COUNT ===============================
+  //
+  // Returns the number of nodes with the given key, i.e. 1 if the key is
+  // present and 0 otherwise.
+
+  std::size_t count(const key_type& x) const{ return _find(x) ? 1 : 0; }
+
+  template<typename K, typename C = comparison_type, typename = typename C::is_transparent>
+  std::size_t count(const K& x) const{ return _find(x) ? 1 : 0; }
+
+
+  // ========================== ORDERED QUERIES =========================
+  //
+  // lower_bound returns an iterator to the first node whose key is not
+  // less than x, upper_bound to the first one whose key is greater than
+  // x (end() if there is none); equal_range returns both of them, i.e.
+  // the range of the nodes with key x, which is empty if x is not
+  // present. As for find, with a transparent comparison operator any type
+  // comparable with the keys can be given.
+
+  iterator lower_bound(const key_type& x){ return iterator{_lower_bound(x), &rightmost}; }
+  const_iterator lower_bound(const key_type& x) const{ return const_iterator{_lower_bound(x), &rightmost}; }
+
+  template<typename K, typename C = comparison_type, typename = typename C::is_transparent>
+  iterator lower_bound(const K& x){ return iterator{_lower_bound(x), &rightmost}; }
+
+  template<typename K, typename C = comparison_type, typename = typename C::is_transparent>
+  const_iterator lower_bound(const K& x) const{ return const_iterator{_lower_bound(x), &rightmost}; }
+
+  iterator upper_bound(const key_type& x){ return iterator{_upper_bound(x), &rightmost}; }
+  const_iterator upper_bound(const key_type& x) const{ return const_iterator{_upper_bound(x), &rightmost}; }
+
+  template<typename K, typename C = comparison_type, typename = typename C::is_transparent>
+  iterator upper_bound(const K& x){ return iterator{_upper_bound(x), &rightmost}; }
+
+  template<typename K, typename C = comparison_type, typename = typename C::is_transparent>
+  const_iterator upper_bound(const K& x) const{ return const_iterator{_upper_bound(x), &rightmost}; }
+
+  std::pair<iterator, iterator> equal_range(const key_type& x){
+
+    return std::make_pair(lower_bound(x), upper_bound(x));
+  }
+
+  std::pair<const_iterator, const_iterator> equal_range(const key_type& x) const{
+
+    return std::make_pair(lower_bound(x), upper_bound(x));
+  }
+
+  template<typename K, typename C = comparison_type, typename = typename C::is_transparent>
+  std::pair<iterator, iterator> equal_range(const K& x){
+
+    return std::make_pair(lower_bound(x), upper_bound(x));
+  }
+
+  template<typename K, typename C = comparison_type, typename = typename C::is_transparent>
+  std::pair<const_iterator, const_iterator> equal_range(const K& x) const{
+
+    return std::make_pair(lower_bound(x), upper_bound(x));
+  }
+
+
+  // ======================== FOR EACH IN RANGE =========================
+  //
+  // Calls f on every key-value pair whose key is in [lo, hi), in order.
+  // The tree is descended once to find the first pair and then only the
+  // k pairs in the range are visited, for a cost of O(log n + k).
+  // Returns f, as std::for_each does.
+
+  template<typename F>
+  F for_each_in_range(const key_type& lo, const key_type& hi, F f){
+
+    for(auto i = lower_bound(lo), stop = end(); i != stop && op(i->first, hi); ++i){ f(*i); }
+
+    return f;
+  }
+
+  template<typename F>
+  F for_each_in_range(const key_type& lo, const key_type& hi, F f) const{
+
+    for(auto i = lower_bound(lo), stop = end(); i != stop && op(i->first, hi); ++i){ f(*i); }
+
+    return f;
+  }
+
+  // =================== PARALLEL FOR EACH and REDUCE ===================
+  //
+  // Visit the whole tree with up to `threads` threads (0 for one per
+  // hardware thread). The pairs are split by rank in chunks of
+  // consecutive pairs, at most 1024 and of at least _parallel_grain pairs
+  // each, so that their bounds depend only on the size of the tree: the
+  // thread taking a chunk finds its first pair with nth() and goes on
+  // from there. parallel_for_each() calls f on every pair, concurrently
+  // on pairs of different chunks. parallel_reduce() combines, starting
+  // from init, the results of map on all the pairs in order: each chunk
+  // is reduced on its own, then the results of the chunks are reduced one
+  // after the other. reduce must thus be associative but need not be
+  // commutative, and the result does not depend on the number of threads.
+  // f, map and reduce are called concurrently and the tree must not be
+  // modified meanwhile.
+
+  template<typename F>
+  void parallel_for_each(F f, std::size_t threads = 0){
+
+    const std::size_t chunks{_chunk_count()};
+
+    _parallel_run(_thread_count(threads), chunks, [&](std::size_t c){
+
+      std::size_t k{node_count * c / chunks};
+
+      for(auto i = nth(k); k < node_count * (c+1) / chunks; ++k, ++i){ f(*i); }
+    });
+  }
+
+  template<typename F>
+  void parallel_for_each(F f, std::size_t threads = 0) const{
+
+    const std::size_t chunks{_chunk_count()};
+
+    _parallel_run(_thread_count(threads), chunks, [&](std::size_t c){
+
+      std::size_t k{node_count * c / chunks};
+
+      for(auto i = nth(k); k < node_count * (c+1) / chunks; ++k, ++i){ f(*i); }
+    });
+  }
+
+  template<typename T, typename M, typename R>
+  T parallel_reduce(T init, M map, R reduce, std::size_t threads = 0) const{
+
+    const std::size_t chunks{_chunk_count()};
+    std::vector<std::optional<T>> partial(chunks);	// result of each chunk
+
+    _parallel_run(_thread_count(threads), chunks, [&](std::size_t c){
+
+      std::size_t k{node_count * c / chunks};
+      auto i = nth(k);
+
+      partial[c].emplace(map(*i));
+
+      for(++k, ++i; k < node_count * (c+1) / chunks; ++k, ++i){ *partial[c] = reduce(std::move(*partial[c]), map(*i)); }
+    });
+
+    for(auto& p : partial){ init = reduce(std::move(init), std::move(*p)); }
+
+    return init;
+  }
+
+  // ============================== SIZE ================================
+  //
+  // Number of nodes of the tree, in O(1).
+
+  std::size_t size() const noexcept{ return node_count; }
+
+  bool empty() const noexcept{ return node_count == 0; }
+
+
+  // ========================= ORDER STATISTICS =========================
+  //
+  // Every node stores the size of its subtree, so nth(k) returns an
+  // iterator to the node with the k-th smallest key (counting from 0, so
+  // nth(size()/2) is the median), or end() if k >= size(), and rank(x)
+  // returns the number of keys less than x, whether x is present or not,
+  // both in O(height). Iterators can also be moved by any number of
+  // positions and subtracted (see iterator.hpp).
+
+  iterator nth(std::size_t k) noexcept{ return iterator{_iterator<pair_type, pair_type>::_select(root, k), &rightmost}; }
+  const_iterator nth(std::size_t k) const noexcept{ return const_iterator{_iterator<pair_type, pair_type>::_select(root, k), &rightmost}; }
+
+  std::size_t rank(const key_type& x) const{ return _rank(x); }
+
+  template<typename K, typename C = comparison_type, typename = typename C::is_transparent>
+  std::size_t rank(const K& x) const{ return _rank(x); }
+
+
+  // ============================ FIND MANY =============================
+  //
+  // Looks for all the keys of the range [first, last), writing
+  // to out, for each of them, the iterator that find() would return.
+  // The searches are performed in groups that go down the tree together,
+  // prefetching the next node of each search (see _find_many()), which
+  // is faster than calling find() for each key when the tree does not
+  // fit in the cache. Returns the output iterator past the last written.
+  // Keys read from an input range, or returned by value, are copied, so
+  // they have to be default constructible and copy assignable.
+
+  template<typename I, typename O>
+  O find_many(I first, I last, O out){ return _find_many<iterator>(first, last, out); }
+
+  template<typename I, typename O>
+  O find_many(I first, I last, O out) const{ return _find_many<const_iterator>(first, last, out); }
 
   
+  // ============================== FREEZE ==============================
+  //
+  // Returns a read-only snapshot of the tree (see frozen.hpp), where the
+  // keys are laid out in a contiguous array in Eytzinger order and the
+  // look-ups are faster. Later changes to the tree are not reflected in
+  // the snapshot.
+
+  frozen_bst<key_type, value_type, comparison_type> freeze() const{
+
+    return frozen_bst<key_type, value_type, comparison_type>{cbegin(), node_count, op};
+  }
+
+
   // ============================= BALANCE ==============================
   //
-  // Simple implementation of balancing a tree. It scans the tree from
-  // begin() to end() and fills a vector with all the key-value pairs,
-  // then the private function _sub_balance finds the middle index of the
-  // vector and inserts the corresponding pair in the tree, then the same 
-  // strategy is applied to the subvectors created this way by recursive
-  // calls of the private function
+  // Balances the tree in place with the Day-Stout-Warren algorithm: the
+  // tree is first turned into a sorted vine by right rotations, then the
+  // vine is turned into a balanced tree by repeated left rotations along
+  // the spine. Only the links of the existing nodes are changed: no pair
+  // is copied, no node is allocated and no extra memory is needed, in
+  // O(n) time.
 
-  void balance(){
+  void balance() noexcept{
 
-    std::vector<pair_type> vec{};      	// empty vector to store the key-value pairs
-    
-    for(const auto& i : *this){        	// ranged for loop inside the tree
-  
-      vec.push_back(i);		       	// copy all the pairs inside the vector
-    }
+    if(!root){ return; }
 
-    this->clear();		       	// clear the tree in order to replace it with its balanced version
+    _tree_to_vine();
 
-    _sub_balance(vec, 0, vec.size()-1); // we delegate the balancing process to a private function
+    _vine_to_tree(node_count);
+
+    _recolour(balancing_policy{});
   }
 
 
   // ====================== SUBSCRIPTING OPERATOR =======================
   //
   // Given a key it returns a reference to the value that is mapped to it,
-  // performing an insertion if such key does not already exist.
+  // performing an insertion if such key does not already exist; the
+  // value is value-initialized inside the new node only in that case.
 
   // l-value
   value_type& operator[](const key_type& x){
   
-    return emplace(x, value_type()).first->second;
+    return try_emplace(x).first->second;
   }
   
   // r-value
   value_type& operator[](key_type&& x){
 
-    return emplace(std::move(x), value_type()).first->second;
+    return try_emplace(std::move(x)).first->second;
   }
   
   
@@ -453,228 +2468,255 @@ class bst{
 
   // ============================== ERASE ==============================
   //
-  // Given a key it finds the corresponding node and deletes it,
-  // re-arranging the tree in a such a way that all the constraints are
-  // respected.
+  // Given a key it finds the corresponding node and deletes it (see
+  // _erase()). With a transparent comparison operator (such as std::less<>)
+  // any type comparable with the keys can be given.
 
-  void erase(const key_type& x){
+  void erase(const key_type& x){ _erase(_find(x)); }
 
-    auto deleted_iterator = find(x);  				// find node to delete, return iterator
+  template<typename K, typename C = comparison_type, typename = typename C::is_transparent>
+  void erase(const K& x){ _erase(_find(x)); }
 
-    auto deleted_node = deleted_iterator.current; 		// access the node inside the iterator
-    
-    if(!deleted_node){ return;}					// if the tree is empty return
 
-    if(deleted_node == root.get()){      			// if the root is being deleted
+  // ============================= EXTRACT =============================
+  //
+  // Unlinks the node the iterator refers to, or the node with the given
+  // key, and returns a node handle owning it (an empty one if the key is
+  // not present). The node is neither destroyed nor copied: it can be
+  // inserted again in this tree or in another one with an equal
+  // allocator, and it is given back to the allocator if the handle is
+  // destroyed still holding it. As in the standard containers, the
+  // transparent overload does not take iterators, which would otherwise
+  // pick it over extract(const_iterator) and be compared with the keys.
 
-      // if the root has no children simply delete it
+  node_type extract(const_iterator pos){ return _extract(pos.current); }
 
-      if( (!deleted_node->left) && (!deleted_node->right)){	
-        root.reset(nullptr);
+  node_type extract(const key_type& x){ return _extract(_find(x)); }
 
-      }else if( (!deleted_node->left) && (deleted_node->right) ){
-       
-      // if the root only has a right child make the child the new root
-        
-        deleted_node->right->parent = nullptr;
-        root.reset( deleted_node->right.release());
+  template<typename K, typename C = comparison_type, typename = typename C::is_transparent,
+           typename = typename std::enable_if<!std::is_convertible<const K&, iterator>::value
+                                              && !std::is_convertible<const K&, const_iterator>::value>::type>
+  node_type extract(const K& x){ return _extract(_find(x)); }
 
-      }else if( (deleted_node->left) && (!deleted_node->right) ){
-       
-      // if the root only has a left child make the child the new root
 
-        deleted_node -> left -> parent = nullptr;
-        root.reset( deleted_node->left.release());
+  // ============================== MERGE ==============================
+  //
+  // Moves into this tree the nodes of the given one whose key is not
+  // present here, by unlinking them from the other tree and linking them
+  // in this one; the others stay where they are. Nothing is allocated or
+  // copied, unless the allocators differ: then the nodes cannot change
+  // tree, so the pairs are moved in new nodes, as join does, and the old
+  // nodes are erased from x.
 
-      }else{
-	 
-      // if the root has both children find its successor in terms
-      // of keys, which will not have a left child for sure, and replace it
-      // with the deleted node, moreover if the successor has a right child 
-      // replace the successor with it
-        
-	auto successor = (++deleted_iterator).current;  // find successor
-
-        // create a new node to store the newly assigned root
-	auto new_root = std::unique_ptr<node<pair_type>>(new node<pair_type>(nullptr, successor->pair));
-	
-        // make left child of new root = left child of deleted and release for deleted
-	new_root.get()->left.reset(deleted_node->left.release()); 
-	
-        // make left child parent = to new root
-	new_root.get()->left.get()->parent = new_root.get();
-
-	// for the right child handle the case in which the successor is the 
-	// right child of the deleted node
-	if( deleted_node->right.get() == successor ){
-    
-	  // the right child of root becomes the right child of the successor
-          new_root.get()->right.reset(successor->right.release());
-          
-          if( new_root.get()->right.get()){
+  void merge(bst& x){
 
-	    // set parent of right child to root
-            new_root.get()->right.get()->parent = new_root.get();
-	  }
+    if(&x == this){ return; }
 
-	}else{
+    if(!(alloc == x.alloc)){
 
-	  // make right child of new root = right child of deleted and release for deleted
-	  new_root.get()->right.reset(deleted_node->right.release());
+      for(auto i = x.begin(), stop = x.end(); i != stop; ){
 
-	  // make right parent = to root
-	  new_root.get()->right.get()->parent = new_root.get();
+        node<pair_type>* n{i.current};
+        ++i;
 
-	  // handle the case in which successor has a right child
-	  if( successor->right ){
+        if(_insert(n->pair.first, std::move(n->pair)).second){ x._extract(n); }	// the handle frees n
+      }
 
-	    // make parent of right child of successor equal to successor parent
-	    successor->right->parent = successor->parent;
-	  
-	    // make right child of successor, left child of successor's parent
-	    successor->parent->left.reset(successor->right.release());
+      return;
+    }
 
-	  }else{
+    for(auto i = x.begin(), stop = x.end(); i != stop; ){
 
-	    // reset successor's parent left child
-	    successor->parent->left.reset();
-          }
-        }
+      node<pair_type>* n{i.current};
+      ++i;					// n is about to leave x
 
-	root.reset(new_root.release());
-      }
+      node<pair_type>* parent;
+      bool left;
+
+      if(_descend(n->pair.first, parent, left)){ continue; }	// the key is already here
 
-     return;
+      x._detach(n);
+      _grow(parent);
+      _link(n, parent, left);
+      ++node_count;
     }
-    
-    // delete any other node, it will for sure have a parent
-    
-    auto parent_deleted = deleted_node->parent;  		// parent of the deleted node
+  }
 
-    // simplest case: the node to delete is a leaf, so it has no children
-    if((!deleted_node->left) && (!deleted_node->right)){
-      
-      // the deleted node is the left child of its parent
-      if( parent_deleted->left.get() == deleted_node ){
+  void merge(bst&& x){ merge(x); }
 
-	parent_deleted->left.reset();
 
-      // the deleted node is the right child of its parent
-      }else if( parent_deleted->right.get() == deleted_node ){ 
-        
-        parent_deleted->right.reset();
-      }
+  // ========================== SPLIT and JOIN =========================
+  //
+  // split(t, x) moves the pairs of t into two trees, the first with the
+  // keys less than x and the second with the others; join(l, r) moves the
+  // pairs of l and r, where all the keys of l must be less than the ones
+  // of r, into a single tree. The nodes are relinked, neither allocated
+  // nor copied: in a red-black tree both cost O(log n), while without
+  // balancing the shape of the result follows the one of the trees. The
+  // trees are taken by value, so they have to be moved in for their
+  // nodes to be reused (otherwise they have to be copied first); if the
+  // allocators differ the pairs of the second tree are moved in new
+  // nodes. The comparison operator must not throw.
+
+  friend std::pair<bst, bst> split(bst t, const key_type& x){
+
+    _subtree l, r;
+    node<pair_type>* m;
+    t._split(t._take(), x, l, r, m);
+
+    if(m){ r = t._join(_subtree{nullptr, 0}, m, r, balancing_policy{}); }
+
+    bst right{t.op, allocator_type(t.alloc)};
+    right._adopt(r);
+    t._adopt(l);
+
+    return std::make_pair(std::move(t), std::move(right));
+  }
+
+  friend bst join(bst l, bst r){
+
+    if(!l.empty() && !r.empty() && !l.op((--l.cend())->first, r.cbegin()->first)){
+
+      throw std::invalid_argument{"join: the keys of the first tree must be less than the ones of the second"};
+    }
+
+    if(!(l.alloc == r.alloc)){
+
+      bst moved{l._rehome(r)};
+      return join(std::move(l), std::move(moved));
+    }
+
+    _subtree tl{l._take()}, tr{r._take()};
+    l._adopt(l._join(tl, tr));
+    return l;
+  }
+
+
+  // ========================= SET OPERATIONS ==========================
+  //
+  // Union, intersection and difference of the keys of two trees, built by
+  // splitting one tree around the root of the other, recurring on the two
+  // halves and joining the results. On red-black trees of sizes m <= n
+  // the work is O(m log(n/m + 1)), instead of the O(m log n) of one look-
+  // up per key, plus the destruction of the nodes left out of the result.
+  // The nodes of the result are the ones of the two trees: for a key in
+  // both trees the pair of the first one is kept and the other node is
+  // destroyed. The trees are taken by value, as for split and join.
+  // Without balancing the depth of the recursion is the height of one of
+  // the trees, which should therefore be balanced first.
+
+  friend bst set_union(bst a, bst b){
+
+    _set_operation(a, b, &bst::_union);
+    return a;
+  }
+
+  friend bst set_intersection(bst a, bst b){
+
+    _set_operation(a, b, &bst::_intersection);
+    return a;
+  }
+
+  friend bst set_difference(bst a, bst b){
+
+    _set_operation(a, b, &bst::_difference);
+    return a;
+  }
+
+
+  // ========================== SAVE and LOAD ===========================
+  //
+  // save() writes the pairs of the tree in order in a compact binary
+  // form: a header, holding the magic string "bst", the version of the
+  // format, the record sizes and the tags of keys and values given by
+  // their serializers (see serializer.hpp) and the number of pairs,
+  // followed by the pairs, key then value. Keys and values of trivially
+  // copyable types are written as raw bytes, copied in blocks. load()
+  // replaces the content of the tree with the pairs written by save() for
+  // the same types: the tags keep apart types of the same size, such as
+  // int, unsigned and float. Since the pairs come sorted and without
+  // duplicates the tree is built by _build_sorted as they are read, in
+  // O(n) and without any comparison, so the data are trusted to be
+  // sorted according to the comparison operator of the tree. If the
+  // header does not match or the data end too early std::runtime_error
+  // is thrown and the tree is left unchanged. Both can be given either a
+  // stream, which should be opened in binary mode, or a file name.
+
+  void save(std::ostream& os) const{
+
+    _header h{{'b', 's', 't', '\0'}, _version, serializer<key_type>::size, serializer<value_type>::size,
+              _serializer_tag<key_type>::value, _serializer_tag<value_type>::value, node_count};
 
-    // 2nd case: the node to delete has a left child
-    }else if( (deleted_node->left) && (!deleted_node->right) ){
-
-      // set child's parent to be the parent of node to delete
-      deleted_node->left->parent = parent_deleted; 
-
-      // the deleted node is the left child of its parent
-      if( parent_deleted->left.get() == deleted_node ){
-      
-        parent_deleted->left.reset(deleted_node->left.release());
-        
-      // the deleted node is the right child of its parent
-      }else if( parent_deleted->right.get() == deleted_node ){
-        
-        parent_deleted->right.reset(deleted_node->left.release());
+    os.write(reinterpret_cast<const char*>(&h), sizeof(h));
+
+    if constexpr(_raw){
+
+      std::vector<char> buf;
+      buf.reserve(_block + _record);
+
+      for(const auto& i : *this){
+
+	buf.resize(buf.size() + _record);
+	std::memcpy(buf.data() + buf.size() - _record, &i.first, sizeof(key_type));
+	std::memcpy(buf.data() + buf.size() - sizeof(value_type), &i.second, sizeof(value_type));
+
+	if(buf.size() >= _block){ os.write(buf.data(), buf.size()); buf.clear(); }
       }
 
-    // 2nd case: the node to delete has a right child
-    }else if( (!deleted_node->left) && (deleted_node->right) ){
+      os.write(buf.data(), buf.size());
 
-      // set child's parent to be the parent of node to delete
-      deleted_node->right->parent = parent_deleted;
-    
-      // the deleted node is the left child of its parent
-      if( parent_deleted->left.get() == deleted_node ){
-    
-        parent_deleted->left.reset(deleted_node->right.release());
-    
-      // the deleted node is the right child of its parent
-      }else if( parent_deleted->right.get() == deleted_node ){
-     
-        parent_deleted->right.reset(deleted_node->right.release());
+    }else{
+
+      for(const auto& i : *this){
+
+	serializer<key_type>::write(os, i.first);
+	serializer<value_type>::write(os, i.second);
       }
+    }
 
-    // 3rd case: the node to delete has both left and right children
-    }else if( (deleted_node->left) && (deleted_node->right) ){
-      
-      // Find its successor in terms of keys, which will for sure 
-      // not have a left child, and replace it with the deleted node
-
-        auto successor = (++deleted_iterator).current;  	// find successor
-
-        // create a new node initialized with the values from the successor
-	// of the deleted node
-        auto new_node = std::unique_ptr<node<pair_type>>(new node<pair_type>(parent_deleted, successor->pair));
-
-        // make left child of new node = left child of deleted and release for deleted
-        new_node.get()->left.reset(deleted_node->left.release());
-
-        // make left child parent = to new node
-        new_node.get()->left.get()->parent = new_node.get();
-
-        // for the right child we need to handle the case in which the successor is the 
-        // right child of the deleted
-        if( deleted_node->right.get() == successor ){
-	  
-          // the right child of the node becomes the right child of the successor
-          new_node.get()->right.reset(successor->right.release());
-          
-          if(new_node.get()->right.get()){  
-	  
-	    // set parent of right child to new node
-            new_node.get()->right.get()->parent = new_node.get();
-          
-          }
-          if( parent_deleted->left.get() == deleted_node){
-            
-            parent_deleted->left.reset(new_node.release());
+    if(!os){ throw std::runtime_error{"bst::save: the data could not be written"}; }
+  }
 
-          }else{   
+  void save(const std::string& path) const{
 
-	    parent_deleted->right.reset(new_node.release());
-          }
+    std::ofstream os{path, std::ios::binary};
 
-	}else{
+    if(!os){ throw std::runtime_error{"bst::save: cannot open " + path}; }
 
-          // make right child of new node = right child of deleted and release for deleted
-          new_node.get()->right.reset(deleted_node->right.release());
+    save(os);
+  }
 
-          // make right parent = to new node
-          new_node.get()->right.get()->parent = new_node.get();
+  void load(std::istream& is){
 
-	  if( parent_deleted->left.get() == deleted_node){
-            
-            parent_deleted->left.reset(new_node.release());
-          
-          }else{   
+    _header h;
 
-            parent_deleted->right.reset(new_node.release());
-          }
+    is.read(reinterpret_cast<char*>(&h), sizeof(h));
 
-          // we need to handle the case in which successor has a right child
-          if( successor->right ){
+    if(!is || std::memcmp(h.magic, "bst", 4) != 0 || h.version != _version || h.key_size != serializer<key_type>::size
+       || h.value_size != serializer<value_type>::size || h.key_tag != _serializer_tag<key_type>::value
+       || h.value_tag != _serializer_tag<value_type>::value){
 
-            // make parent of right child of successor equal to successor parent
-            successor->right->parent = successor->parent;
+      throw std::runtime_error{"bst::load: the data do not hold a tree of this type"};
+    }
 
-            // make right child of successor, left child of successor's parent
-            successor->parent->left.reset(successor->right.release());
+    bst tmp{op, allocator_type(alloc)};
+    _reader it{is, h.count, {}, 0};
 
-          }else{
+    tmp.root = tmp._build_sorted(it, h.count);
+    tmp._update_extrema();
+    tmp._recolour(balancing_policy{});
 
-            // reset successor's parent left child
-            successor->parent->left.reset();
-          }
-        }
-      }
-      // the tree is empty or the key we are deleting is not present
-      return;
-    } 
+    *this = std::move(tmp);
+  }
+
+  void load(const std::string& path){
+
+    std::ifstream is{path, std::ios::binary};
+
+    if(!is){ throw std::runtime_error{"bst::load: cannot open " + path}; }
+
+    load(is);
+  }
 
 
   // ============================== PRINT ==============================
@@ -704,4 +2746,13 @@ class bst{
   } 
 };
 
+
+// ============================== RB_BST ===============================
+//
+// Shorthand for a red-black binary search tree.
+
+template<typename key_type, typename value_type, typename comparison_type = std::less<key_type> >
+using rb_bst = bst<key_type, value_type, comparison_type,
+                   std::allocator<std::pair<const key_type, value_type>>, red_black_balancing>;
+
 #endif
@@ -0,0 +1,1237 @@
+#ifndef btree_hpp
+#define btree_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+
+// ============================ SIMD COUNT ===============================
+//
+// Counting how many keys of a node are less (or greater) than the searched
+// one gives the position of the key inside the node, and the child to go
+// down to. For integer keys the keys are compared with the searched one a
+// whole vector register at a time and the results are collected with
+// movemask and popcount, without any branch; for the other types the
+// generic version falls back to a scalar loop.
+// Unsigned keys are compared as signed ones after flipping their sign bit.
+
+template<typename K>
+struct _simd_count{
+
+  static constexpr bool enabled{false};
+};
+
+#if defined(__SSE2__)
+
+// number of keys less than x (lt) or greater than x (gt), 32 bit keys
+template<bool greater>
+inline unsigned _simd_count_32(const std::int32_t* keys, unsigned n, std::int32_t x, std::int32_t bias) noexcept{
+
+  unsigned c{0};
+  unsigned i{0};
+
+#if defined(__AVX2__)
+  const __m256i xv8 = _mm256_set1_epi32(x ^ bias);
+  const __m256i bias8 = _mm256_set1_epi32(bias);
+
+  for(; i+8 <= n; i += 8){
+
+    __m256i k = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys+i)), bias8);
+    __m256i m = greater ? _mm256_cmpgt_epi32(k, xv8) : _mm256_cmpgt_epi32(xv8, k);
+    c += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(m)));
+  }
+#endif
+
+  const __m128i xv4 = _mm_set1_epi32(x ^ bias);
+  const __m128i bias4 = _mm_set1_epi32(bias);
+
+  for(; i+4 <= n; i += 4){
+
+    __m128i k = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys+i)), bias4);
+    __m128i m = greater ? _mm_cmpgt_epi32(k, xv4) : _mm_cmplt_epi32(k, xv4);
+    c += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(m)));
+  }
+
+  for(; i < n; ++i){
+
+    c += greater ? ((keys[i] ^ bias) > (x ^ bias)) : ((keys[i] ^ bias) < (x ^ bias));
+  }
+
+  return c;
+}
+
+template<>
+struct _simd_count<std::int32_t>{
+
+  static constexpr bool enabled{true};
+
+  static unsigned lt(const std::int32_t* k, unsigned n, std::int32_t x) noexcept{ return _simd_count_32<false>(k, n, x, 0); }
+  static unsigned gt(const std::int32_t* k, unsigned n, std::int32_t x) noexcept{ return _simd_count_32<true>(k, n, x, 0); }
+};
+
+template<>
+struct _simd_count<std::uint32_t>{
+
+  static constexpr bool enabled{true};
+
+  static unsigned lt(const std::uint32_t* k, unsigned n, std::uint32_t x) noexcept{
+
+    return _simd_count_32<false>(reinterpret_cast<const std::int32_t*>(k), n, static_cast<std::int32_t>(x), INT32_MIN);
+  }
+
+  static unsigned gt(const std::uint32_t* k, unsigned n, std::uint32_t x) noexcept{
+
+    return _simd_count_32<true>(reinterpret_cast<const std::int32_t*>(k), n, static_cast<std::int32_t>(x), INT32_MIN);
+  }
+};
+
+#endif
+
+#if defined(__SSE4_2__)
+
+// number of keys less than x (lt) or greater than x (gt), 64 bit keys
+template<bool greater>
+inline unsigned _simd_count_64(const std::int64_t* keys, unsigned n, std::int64_t x, std::int64_t bias) noexcept{
+
+  unsigned c{0};
+  unsigned i{0};
+
+#if defined(__AVX2__)
+  const __m256i xv4 = _mm256_set1_epi64x(x ^ bias);
+  const __m256i bias4 = _mm256_set1_epi64x(bias);
+
+  for(; i+4 <= n; i += 4){
+
+    __m256i k = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys+i)), bias4);
+    __m256i m = greater ? _mm256_cmpgt_epi64(k, xv4) : _mm256_cmpgt_epi64(xv4, k);
+    c += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(m)));
+  }
+#endif
+
+  const __m128i xv2 = _mm_set1_epi64x(x ^ bias);
+  const __m128i bias2 = _mm_set1_epi64x(bias);
+
+  for(; i+2 <= n; i += 2){
+
+    __m128i k = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys+i)), bias2);
+    __m128i m = greater ? _mm_cmpgt_epi64(k, xv2) : _mm_cmpgt_epi64(xv2, k);
+    c += __builtin_popcount(_mm_movemask_pd(_mm_castsi128_pd(m)));
+  }
+
+  for(; i < n; ++i){
+
+    c += greater ? ((keys[i] ^ bias) > (x ^ bias)) : ((keys[i] ^ bias) < (x ^ bias));
+  }
+
+  return c;
+}
+
+template<>
+struct _simd_count<std::int64_t>{
+
+  static constexpr bool enabled{true};
+
+  static unsigned lt(const std::int64_t* k, unsigned n, std::int64_t x) noexcept{ return _simd_count_64<false>(k, n, x, 0); }
+  static unsigned gt(const std::int64_t* k, unsigned n, std::int64_t x) noexcept{ return _simd_count_64<true>(k, n, x, 0); }
+};
+
+template<>
+struct _simd_count<std::uint64_t>{
+
+  static constexpr bool enabled{true};
+
+  static unsigned lt(const std::uint64_t* k, unsigned n, std::uint64_t x) noexcept{
+
+    return _simd_count_64<false>(reinterpret_cast<const std::int64_t*>(k), n, static_cast<std::int64_t>(x), INT64_MIN);
+  }
+
+  static unsigned gt(const std::uint64_t* k, unsigned n, std::uint64_t x) noexcept{
+
+    return _simd_count_64<true>(reinterpret_cast<const std::int64_t*>(k), n, static_cast<std::int64_t>(x), INT64_MIN);
+  }
+};
+
+#endif
+
+
+// ============================ KEY SEARCH ===============================
+//
+// before(keys, n, x) counts the keys k of a node such that op(k, x), i.e.
+// it gives the position of the first key not less than x; after(keys, n,
+// x) counts the keys such that op(x, k). The vectorised versions are used
+// for integer keys compared with std::less or std::greater.
+
+template<typename K, typename C, bool = _simd_count<K>::enabled>
+struct _key_search{
+
+  static unsigned before(const K* keys, unsigned n, const K& x, const C& op){
+
+    unsigned c{0};
+
+    for(unsigned i{0}; i < n; ++i){ c += op(keys[i], x) ? 1 : 0; }
+
+    return c;
+  }
+
+  static unsigned after(const K* keys, unsigned n, const K& x, const C& op){
+
+    unsigned c{0};
+
+    for(unsigned i{0}; i < n; ++i){ c += op(x, keys[i]) ? 1 : 0; }
+
+    return c;
+  }
+};
+
+template<typename K>
+struct _key_search<K, std::less<K>, true>{
+
+  static unsigned before(const K* keys, unsigned n, const K& x, const std::less<K>&) noexcept{ return _simd_count<K>::lt(keys, n, x); }
+  static unsigned after(const K* keys, unsigned n, const K& x, const std::less<K>&) noexcept{ return _simd_count<K>::gt(keys, n, x); }
+};
+
+template<typename K>
+struct _key_search<K, std::greater<K>, true>{
+
+  static unsigned before(const K* keys, unsigned n, const K& x, const std::greater<K>&) noexcept{ return _simd_count<K>::gt(keys, n, x); }
+  static unsigned after(const K* keys, unsigned n, const K& x, const std::greater<K>&) noexcept{ return _simd_count<K>::lt(keys, n, x); }
+};
+
+
+// ============================== NODES ==================================
+//
+// Nodes of the B-tree. Every node stores up to C sorted keys in a
+// contiguous array, which spans one or two cache lines: the array comes
+// first and is aligned to 64 bytes, so that it starts a cache line.
+// Inner nodes store the keys separating their C+1 children: all the keys
+// in the subtree of children[i] are less than keys[i], which is not
+// greater than any key in the subtree of children[i+1].
+// Leaves store the values in a parallel array and are linked in a list,
+// in order, which is walked by the iterators.
+
+template<typename K, unsigned C>
+struct _btree_node{
+
+  alignas(64) K keys[C];	// sorted keys
+  unsigned count;	// number of keys stored in the node
+  bool leaf;		// whether the node is a leaf
+};
+
+template<typename K, unsigned C>
+struct _btree_inner: _btree_node<K, C>{
+
+  _btree_node<K, C>* children[C+1];
+};
+
+template<typename K, typename V, unsigned C>
+struct _btree_leaf: _btree_node<K, C>{
+
+  V values[C];			// values, parallel to the keys
+  _btree_leaf* prev;		// previous leaf in key order
+  _btree_leaf* next;		// next leaf in key order
+};
+
+
+// ========================== BTREE ITERATOR =============================
+//
+// Bidirectional iterator for the B-tree: it refers to a position inside a
+// leaf. Keys and values are stored apart, so the iterator gives back a
+// pair of references to them; as for the iterator of bst, it keeps the
+// address of the last leaf of the tree to step back from end().
+
+template<typename K, typename V, unsigned C, typename R>
+class _btree_iterator{
+
+  using leaf_type = _btree_leaf<K, V, C>;
+
+  leaf_type* current;			// leaf referred to by the iterator
+  unsigned index;			// position inside the leaf
+  leaf_type* const* last;		// address of the last leaf of the tree
+
+  public:
+  using value_type = std::pair<const K, V>;
+  using difference_type = std::ptrdiff_t;
+  using iterator_category = std::bidirectional_iterator_tag;
+  using reference = std::pair<const K&, R&>;
+
+  // helper returned by the arrow operator
+  struct pointer{
+
+    reference pair;
+    const reference* operator->() const noexcept{ return &pair; }
+  };
+
+  _btree_iterator(leaf_type* l, unsigned i, leaf_type* const* lst) noexcept: current{l}, index{i}, last{lst} {}
+
+  // a non-constant iterator can be converted to a constant one
+  template<typename RR, typename = typename std::enable_if<std::is_same<const RR, R>::value>::type>
+  _btree_iterator(const _btree_iterator<K, V, C, RR>& x) noexcept: current{x.current}, index{x.index}, last{x.last} {}
+
+  // de-reference operator
+  reference operator*() const noexcept{ return reference{current->keys[index], current->values[index]}; }
+
+  // arrow operator
+  pointer operator->() const noexcept{ return pointer{*(*this)}; }
+
+  // pre increment operator: next position in the leaf or first of the next leaf
+  _btree_iterator& operator++() noexcept{
+
+    if(!current){ return *this; }
+
+    if(++index == current->count){
+
+      current = current->next;
+      index = 0;
+    }
+
+    return *this;
+  }
+
+  // post increment
+  _btree_iterator operator++(int) noexcept{
+
+    auto tmp{*this};
+    ++(*this);
+    return tmp;
+  }
+
+  // pre decrement operator: previous position in the leaf or last of the
+  // previous leaf; stepping back from end() leads to the last pair
+  _btree_iterator& operator--() noexcept{
+
+    if(!current){
+
+      current = *last;
+      index = current->count;
+
+    }else if(index == 0){
+
+      current = current->prev;
+      index = current->count;
+    }
+
+    --index;
+    return *this;
+  }
+
+  // post decrement
+  _btree_iterator operator--(int) noexcept{
+
+    auto tmp{*this};
+    --(*this);
+    return tmp;
+  }
+
+  // Equality operator
+  friend
+  bool operator==(const _btree_iterator& a, const _btree_iterator& b){
+
+    return a.current == b.current && a.index == b.index;
+  }
+
+  // Inequality operator
+  friend
+  bool operator!=(const _btree_iterator& a, const _btree_iterator& b){
+
+    return !(a==b);
+  }
+
+  template<typename KK, typename VV, unsigned CC, typename RR>
+  friend class _btree_iterator;
+
+  template<typename KK, typename VV, typename CC>
+  friend class btree;
+};
+
+
+// ============================= BTREE CLASS =============================
+//
+// Ordered associative container with the same interface as bst, where
+// each node stores many keys (two cache lines worth of them) instead of
+// one, so that a look-up touches far fewer cache lines: with 32 bit keys
+// a node holds 32 keys and a tree of a million keys is only 4 levels
+// deep. Inside each node the position of a key is found by counting the
+// keys less than it, with SIMD instructions for integer keys (see
+// _key_search). The tree is always balanced: all the leaves are at the
+// same depth and every node except the root is at least half full.
+// Keys and values must be default constructible and move assignable,
+// since they are stored in fixed-size arrays.
+
+template<typename key_type, typename value_type, typename comparison_type = std::less<key_type> >
+class btree{
+
+  // number of keys stored in each node
+  static constexpr unsigned capacity{128/sizeof(key_type) > 4 ? unsigned(128/sizeof(key_type)) : 4u};
+
+  // minimum number of keys in the leaves and in the inner nodes, except the root
+  static constexpr unsigned min_leaf{capacity/2};
+  static constexpr unsigned min_inner{(capacity-1)/2};
+
+  // maximum depth of the tree, enough for any number of keys
+  static constexpr unsigned max_depth{64};
+
+  using node_type = _btree_node<key_type, capacity>;
+  using inner_type = _btree_inner<key_type, capacity>;
+  using leaf_type = _btree_leaf<key_type, value_type, capacity>;
+  using search = _key_search<key_type, comparison_type>;
+
+  public:
+  using pair_type = typename std::pair<const key_type, value_type>;
+  using iterator = _btree_iterator<key_type, value_type, capacity, value_type>;
+  using const_iterator = _btree_iterator<key_type, value_type, capacity, const value_type>;
+
+  private:
+
+  comparison_type op;		// comparison operator
+
+  node_type* root;		// pointer to the root node
+
+  leaf_type* first;		// leftmost leaf
+
+  leaf_type* last;		// rightmost leaf
+
+  std::size_t n;		// number of pairs
+
+  //============================ _NEW_LEAF ==============================
+  //
+  // Private auxiliary functions that create empty nodes.
+
+  static leaf_type* _new_leaf(){
+
+    auto l = new leaf_type{};
+    l->leaf = true;
+    l->count = 0;
+    l->prev = nullptr;
+    l->next = nullptr;
+    return l;
+  }
+
+  static inner_type* _new_inner(){
+
+    auto in = new inner_type{};
+    in->leaf = false;
+    in->count = 0;
+    return in;
+  }
+
+  //============================ _DESTROY ===============================
+  //
+  // A private auxiliary function that deletes a subtree. The recursion
+  // depth is the height of the tree, which is logarithmic with a large
+  // base.
+
+  static void _destroy(node_type* x) noexcept{
+
+    if(!x){ return; }
+
+    if(x->leaf){
+
+      delete static_cast<leaf_type*>(x);
+      return;
+    }
+
+    auto in = static_cast<inner_type*>(x);
+
+    for(unsigned i{0}; i <= in->count; ++i){ _destroy(in->children[i]); }
+
+    delete in;
+  }
+
+  //============================= _CLONE ================================
+  //
+  // A private auxiliary function that performs a deep copy of a subtree,
+  // linking the copied leaves one after the other.
+
+  node_type* _clone(const node_type* x, leaf_type*& prev){
+
+    if(x->leaf){
+
+      auto from = static_cast<const leaf_type*>(x);
+      auto to = _new_leaf();
+
+      try{
+
+        for(unsigned i{0}; i < from->count; ++i){
+
+          to->keys[i] = from->keys[i];
+          to->values[i] = from->values[i];
+        }
+
+      }catch(...){
+
+        delete to;
+        throw;
+      }
+
+      to->count = from->count;
+
+      to->prev = prev;
+
+      if(prev){ prev->next = to; }
+      else{ first = to; }
+
+      prev = to;
+      last = to;
+      return to;
+    }
+
+    auto from = static_cast<const inner_type*>(x);
+    auto to = _new_inner();
+
+    try{
+
+      for(unsigned i{0}; i <= from->count; ++i){
+
+        to->children[i] = _clone(from->children[i], prev);
+        to->count = i;				// children[0..i] are valid
+      }
+
+    }catch(...){
+
+      _destroy(to);
+      throw;
+    }
+
+    to->count = from->count;
+
+    for(unsigned i{0}; i < from->count; ++i){ to->keys[i] = from->keys[i]; }
+
+    return to;
+  }
+
+  //============================= _CHILD ================================
+  //
+  // A private auxiliary function that returns the index of the child of
+  // an inner node where the key x has to be looked for, i.e. the number
+  // of keys not greater than x.
+
+  unsigned _child(const inner_type* in, const key_type& x) const{
+
+    return in->count - search::after(in->keys, in->count, x, op);
+  }
+
+  //============================= _FIND ================================
+  //
+  // A private auxiliary function that finds the leaf where the key x is
+  // or would be, and the position of the first key not less than x.
+
+  std::pair<leaf_type*, unsigned> _find(const key_type& x) const{
+
+    if(!root){ return std::make_pair(nullptr, 0u); }
+
+    auto tmp = root;
+
+    while(!tmp->leaf){
+
+      auto in = static_cast<const inner_type*>(tmp);
+      tmp = in->children[_child(in, x)];
+    }
+
+    auto l = static_cast<leaf_type*>(tmp);
+
+    return std::make_pair(l, search::before(l->keys, l->count, x, op));
+  }
+
+  //========================== _LEAF_INSERT =============================
+  //
+  // Private auxiliary functions that insert a pair in a leaf, or a key and
+  // the child on its right in an inner node, at the given position,
+  // shifting the following ones.
+
+  template<typename O>
+  static void _leaf_insert(leaf_type* l, unsigned p, O&& x){
+
+    for(unsigned j{l->count}; j > p; --j){
+
+      l->keys[j] = std::move(l->keys[j-1]);
+      l->values[j] = std::move(l->values[j-1]);
+    }
+
+    l->keys[p] = x.first;
+    l->values[p] = std::forward<O>(x).second;
+    ++l->count;
+  }
+
+  static void _inner_insert(inner_type* in, unsigned p, key_type&& k, node_type* child){
+
+    for(unsigned j{in->count}; j > p; --j){
+
+      in->keys[j] = std::move(in->keys[j-1]);
+      in->children[j+1] = in->children[j];
+    }
+
+    in->keys[p] = std::move(k);
+    in->children[p+1] = child;
+    ++in->count;
+  }
+
+  //========================== _INNER_REMOVE ============================
+  //
+  // A private auxiliary function that removes the key in position p of an
+  // inner node together with the child on its right.
+
+  static void _inner_remove(inner_type* in, unsigned p){
+
+    for(unsigned j{p}; j+1 < in->count; ++j){
+
+      in->keys[j] = std::move(in->keys[j+1]);
+      in->children[j+1] = in->children[j+2];
+    }
+
+    --in->count;
+  }
+
+  //============================= _INSERT ===============================
+  //
+  // A private auxiliary function that performs insertion of a new pair.
+  // We go down to the leaf where the key belongs, remembering the path.
+  // If the leaf is full it is split in two halves and the first key of
+  // the right half is inserted in the parent as separator; if the parent
+  // is full as well it is split in turn, and so on up to the root, which
+  // may be split growing the tree by one level. All the nodes a split
+  // needs are allocated before anything is moved, so that if an allocation
+  // throws the tree is left as it was.
+
+  template<typename O>
+  std::pair<iterator, bool> _insert(O&& x){
+
+    if(!root){
+
+      auto l = _new_leaf();
+      root = first = last = l;
+    }
+
+    inner_type* path[max_depth];	// inner nodes on the path from the root
+    unsigned path_index[max_depth];	// child taken in each of them
+    unsigned depth{0};
+
+    auto tmp = root;
+
+    while(!tmp->leaf){
+
+      auto in = static_cast<inner_type*>(tmp);
+      unsigned i{_child(in, x.first)};
+
+      path[depth] = in;
+      path_index[depth] = i;
+      ++depth;
+
+      tmp = in->children[i];
+    }
+
+    auto l = static_cast<leaf_type*>(tmp);
+    unsigned p{search::before(l->keys, l->count, x.first, op)};
+
+    if(p < l->count && !op(x.first, l->keys[p])){	// the key is already present
+
+      return std::make_pair(iterator{l, p, &last}, false);
+    }
+
+    if(l->count < capacity){				// there is room in the leaf
+
+      _leaf_insert(l, p, std::forward<O>(x));
+      ++n;
+      return std::make_pair(iterator{l, p, &last}, true);
+    }
+
+    // allocate the new leaf and a new inner node for each full ancestor,
+    // plus the new root if they are all full
+
+    unsigned splits{0};
+
+    while(splits < depth && path[depth-1-splits]->count == capacity){ ++splits; }
+
+    inner_type* spare[max_depth+1];	// new inner nodes, used bottom up
+    unsigned spares{splits == depth ? splits + 1 : splits};
+    unsigned used{0};
+    leaf_type* r{nullptr};
+
+    try{
+
+      r = _new_leaf();
+
+      for(; used < spares; ++used){ spare[used] = _new_inner(); }
+
+    }catch(...){
+
+      delete r;
+      for(unsigned j{0}; j < used; ++j){ delete spare[j]; }
+      throw;
+    }
+
+    used = 0;
+
+    // split the leaf, moving its upper half in the new leaf on its right
+
+    unsigned mid{capacity/2};
+
+    for(unsigned j{mid}; j < capacity; ++j){
+
+      r->keys[j-mid] = std::move(l->keys[j]);
+      r->values[j-mid] = std::move(l->values[j]);
+    }
+
+    r->count = capacity - mid;
+    l->count = mid;
+
+    r->prev = l;
+    r->next = l->next;
+
+    if(l->next){ l->next->prev = r; }
+    else{ last = r; }
+
+    l->next = r;
+
+    leaf_type* target{p <= mid ? l : r};
+    unsigned q{p <= mid ? p : p - mid};
+
+    _leaf_insert(target, q, std::forward<O>(x));
+
+    // insert the separator in the parent, splitting it if needed
+
+    key_type separator{r->keys[0]};
+    node_type* right{r};
+
+    while(true){
+
+      if(depth == 0){					// the root has been split
+
+        auto new_root = spare[used++];
+        new_root->count = 1;
+        new_root->keys[0] = std::move(separator);
+        new_root->children[0] = root;
+        new_root->children[1] = right;
+        root = new_root;
+        break;
+      }
+
+      --depth;
+      auto parent = path[depth];
+      unsigned i{path_index[depth]};
+
+      if(parent->count < capacity){
+
+        _inner_insert(parent, i, std::move(separator), right);
+        break;
+      }
+
+      // split the parent: the middle key goes up, the upper half moves in
+      // a new inner node on its right
+
+      auto new_inner = spare[used++];
+      unsigned m{capacity/2};
+      key_type up{std::move(parent->keys[m])};
+
+      for(unsigned j{m+1}; j < capacity; ++j){
+
+        new_inner->keys[j-m-1] = std::move(parent->keys[j]);
+      }
+
+      for(unsigned j{m+1}; j <= capacity; ++j){
+
+        new_inner->children[j-m-1] = parent->children[j];
+      }
+
+      new_inner->count = capacity - m - 1;
+      parent->count = m;
+
+      if(i <= m){ _inner_insert(parent, i, std::move(separator), right); }
+      else{ _inner_insert(new_inner, i-m-1, std::move(separator), right); }
+
+      separator = std::move(up);
+      right = new_inner;
+    }
+
+    ++n;
+    return std::make_pair(iterator{target, q, &last}, true);
+  }
+
+  //========================== _FIX_LEAF ================================
+  //
+  // A private auxiliary function called when the leaf l, child i of
+  // parent, has less than min_leaf keys: a key is borrowed from a sibling
+  // with more than the minimum number of keys, otherwise the leaf is
+  // merged with a sibling, removing a key from the parent. Returns true
+  // if the parent lost a key.
+
+  bool _fix_leaf(leaf_type* l, inner_type* parent, unsigned i){
+
+    auto left = i > 0 ? static_cast<leaf_type*>(parent->children[i-1]) : nullptr;
+    auto right = i < parent->count ? static_cast<leaf_type*>(parent->children[i+1]) : nullptr;
+
+    if(left && left->count > min_leaf){		// borrow the last pair of the left sibling
+
+      _leaf_insert(l, 0, std::make_pair(std::move(left->keys[left->count-1]),
+                                        std::move(left->values[left->count-1])));
+      --left->count;
+      parent->keys[i-1] = l->keys[0];
+      return false;
+    }
+
+    if(right && right->count > min_leaf){	// borrow the first pair of the right sibling
+
+      l->keys[l->count] = std::move(right->keys[0]);
+      l->values[l->count] = std::move(right->values[0]);
+      ++l->count;
+
+      for(unsigned j{1}; j < right->count; ++j){
+
+        right->keys[j-1] = std::move(right->keys[j]);
+        right->values[j-1] = std::move(right->values[j]);
+      }
+
+      --right->count;
+      parent->keys[i] = right->keys[0];
+      return false;
+    }
+
+    // merge with a sibling: the right one of the two is emptied into the
+    // left one and deleted
+
+    if(!left){
+
+      left = l;
+      l = right;
+      ++i;
+    }
+
+    for(unsigned j{0}; j < l->count; ++j){
+
+      left->keys[left->count + j] = std::move(l->keys[j]);
+      left->values[left->count + j] = std::move(l->values[j]);
+    }
+
+    left->count += l->count;
+    left->next = l->next;
+
+    if(l->next){ l->next->prev = left; }
+    else{ last = left; }
+
+    delete l;
+
+    _inner_remove(parent, i-1);
+    return true;
+  }
+
+  //========================== _FIX_INNER ===============================
+  //
+  // Same as _fix_leaf for an inner node: the keys are rotated through the
+  // separator in the parent, and when merging the separator comes down
+  // between the keys of the two nodes.
+
+  bool _fix_inner(inner_type* in, inner_type* parent, unsigned i){
+
+    auto left = i > 0 ? static_cast<inner_type*>(parent->children[i-1]) : nullptr;
+    auto right = i < parent->count ? static_cast<inner_type*>(parent->children[i+1]) : nullptr;
+
+    if(left && left->count > min_inner){	// rotate a key from the left sibling
+
+      for(unsigned j{in->count}; j > 0; --j){
+
+        in->keys[j] = std::move(in->keys[j-1]);
+      }
+
+      for(unsigned j{in->count+1}; j > 0; --j){
+
+        in->children[j] = in->children[j-1];
+      }
+
+      in->keys[0] = std::move(parent->keys[i-1]);
+      in->children[0] = left->children[left->count];
+      ++in->count;
+
+      parent->keys[i-1] = std::move(left->keys[left->count-1]);
+      --left->count;
+      return false;
+    }
+
+    if(right && right->count > min_inner){	// rotate a key from the right sibling
+
+      in->keys[in->count] = std::move(parent->keys[i]);
+      in->children[in->count+1] = right->children[0];
+      ++in->count;
+
+      parent->keys[i] = std::move(right->keys[0]);
+
+      for(unsigned j{1}; j < right->count; ++j){
+
+        right->keys[j-1] = std::move(right->keys[j]);
+      }
+
+      for(unsigned j{1}; j <= right->count; ++j){
+
+        right->children[j-1] = right->children[j];
+      }
+
+      --right->count;
+      return false;
+    }
+
+    if(!left){
+
+      left = in;
+      in = right;
+      ++i;
+    }
+
+    left->keys[left->count] = std::move(parent->keys[i-1]);
+
+    for(unsigned j{0}; j < in->count; ++j){
+
+      left->keys[left->count + 1 + j] = std::move(in->keys[j]);
+    }
+
+    for(unsigned j{0}; j <= in->count; ++j){
+
+      left->children[left->count + 1 + j] = in->children[j];
+    }
+
+    left->count += 1 + in->count;
+
+    delete in;
+
+    _inner_remove(parent, i-1);
+    return true;
+  }
+
+
+  public:
+
+  // ctor for an empty btree
+
+  btree() noexcept: op{}, root{nullptr}, first{nullptr}, last{nullptr}, n{0} {}
+
+  // ctor for an empty btree specifying the comparison operator
+
+  explicit btree(comparison_type comp) noexcept: op{comp}, root{nullptr}, first{nullptr}, last{nullptr}, n{0} {}
+
+  // dtor
+
+  ~btree() noexcept{ clear(); }
+
+
+  //========================== COPY SEMANTICS ============================
+
+  // COPY CONSTRUCTOR:
+  // Deep copy of the tree, node by node.
+
+  explicit btree(const btree& x): op{x.op}, root{nullptr}, first{nullptr}, last{nullptr}, n{0} {
+
+    leaf_type* prev{nullptr};
+
+    if(x.root){ root = _clone(x.root, prev); }
+
+    n = x.n;
+  }
+
+  // COPY ASSIGNMENT:
+  // Copy and swap: the copy is built aside and then moved in, so that if
+  // an allocation or the copy of a pair throws the tree is left as it was.
+
+  btree& operator=(const btree& x){
+
+    if(this == &x){ return *this; }
+
+    btree tmp{x};
+
+    return *this = std::move(tmp);
+  }
+
+
+  //========================== MOVE SEMANTICS ============================
+
+  // MOVE CONSTRUCTOR
+
+  btree(btree&& x) noexcept: op{std::move(x.op)}, root{x.root}, first{x.first}, last{x.last}, n{x.n} {
+
+    x.root = nullptr;
+    x.first = nullptr;
+    x.last = nullptr;
+    x.n = 0;
+  }
+
+  // MOVE ASSIGNMENT
+
+  btree& operator=(btree&& x) noexcept{
+
+    clear();
+
+    op = std::move(x.op);
+    root = x.root;
+    first = x.first;
+    last = x.last;
+    n = x.n;
+
+    x.root = nullptr;
+    x.first = nullptr;
+    x.last = nullptr;
+    x.n = 0;
+
+    return *this;
+  }
+
+
+  //============================= INSERT ===============================
+  //
+  // Inserts a key-value pair, if the key is not already present. A pair
+  // is returned, where the first element is an iterator to the pair with
+  // the given key and the second one tells whether it has been inserted.
+
+  // l-value
+  std::pair<iterator, bool> insert(const pair_type& x){ return _insert(x); }
+
+  // r-value
+  std::pair<iterator, bool> insert(pair_type&& x){ return _insert(std::move(x)); }
+
+
+  //============================= EMPLACE ==============================
+  //
+  // Builds a key-value pair out of the given arguments and inserts it.
+
+  template< class... Types >
+  std::pair<iterator,bool> emplace(Types&&... args){
+
+    return insert(pair_type{std::forward<Types>(args)...});
+  }
+
+
+  // ============================= CLEAR ================================
+  //
+  // Clears the content of the tree.
+
+  void clear() noexcept{
+
+    _destroy(root);
+
+    root = nullptr;
+    first = nullptr;
+    last = nullptr;
+    n = 0;
+  }
+
+
+  // ========================== BEGIN and END ===========================
+
+  iterator begin() noexcept{ return iterator{first, 0, &last}; }
+  const_iterator begin() const noexcept{ return const_iterator{first, 0, &last}; }
+  const_iterator cbegin() const noexcept{ return const_iterator{first, 0, &last}; }
+
+  iterator end() noexcept{ return iterator{nullptr, 0, &last}; }
+  const_iterator end() const noexcept{ return const_iterator{nullptr, 0, &last}; }
+  const_iterator cend() const noexcept{ return const_iterator{nullptr, 0, &last}; }
+
+
+  // ============================== FIND ================================
+  //
+  // Finds the pair with the given key, returning end() if it is not
+  // present.
+
+  iterator find(const key_type& x){
+
+    auto f = _find(x);
+
+    if(f.first && f.second < f.first->count && !op(x, f.first->keys[f.second])){
+
+      return iterator{f.first, f.second, &last};
+    }
+
+    return end();
+  }
+
+  const_iterator find(const key_type& x) const{ return const_cast<btree*>(this)->find(x); }
+
+
+  // ============================= BALANCE ==============================
+  //
+  // A B-tree is always balanced, nothing has to be done. It is provided
+  // for compatibility with bst.
+
+  void balance() noexcept{}
+
+
+  // ============================== SIZE ================================
+
+  std::size_t size() const noexcept{ return n; }
+
+  bool empty() const noexcept{ return n == 0; }
+
+
+  // ====================== SUBSCRIPTING OPERATOR =======================
+  //
+  // Given a key it returns a reference to the value that is mapped to it,
+  // performing an insertion if such key does not already exist.
+
+  // l-value
+  value_type& operator[](const key_type& x){
+
+    return emplace(x, value_type()).first->second;
+  }
+
+  // r-value
+  value_type& operator[](key_type&& x){
+
+    return emplace(std::move(x), value_type()).first->second;
+  }
+
+
+  // ========================= PUT TO OPERATOR =========================
+  //
+  // Prints keys and values from the smallest to the largest key.
+
+  friend
+  std::ostream& operator<<(std::ostream& os, const btree& x){
+
+    os << "Key:\t" << "Value:\n";
+
+    for(const auto& i : x){
+
+      os << i.first  << "   \t" << i.second << "\n";
+    }
+
+    return os;
+  }
+
+
+  // ============================== ERASE ==============================
+  //
+  // Given a key it finds the corresponding pair and removes it from its
+  // leaf. If the leaf is left with less than half of its keys it borrows
+  // one from a sibling or is merged with it, and the same may happen to
+  // its ancestors; if the root is left without keys its only child
+  // becomes the new root.
+
+  void erase(const key_type& x){
+
+    if(!root){ return; }
+
+    inner_type* path[max_depth];
+    unsigned path_index[max_depth];
+    unsigned depth{0};
+
+    auto tmp = root;
+
+    while(!tmp->leaf){
+
+      auto in = static_cast<inner_type*>(tmp);
+      unsigned i{_child(in, x)};
+
+      path[depth] = in;
+      path_index[depth] = i;
+      ++depth;
+
+      tmp = in->children[i];
+    }
+
+    auto l = static_cast<leaf_type*>(tmp);
+    unsigned p{search::before(l->keys, l->count, x, op)};
+
+    if(p == l->count || op(x, l->keys[p])){ return; }	// the key is not present
+
+    for(unsigned j{p+1}; j < l->count; ++j){
+
+      l->keys[j-1] = std::move(l->keys[j]);
+      l->values[j-1] = std::move(l->values[j]);
+    }
+
+    --l->count;
+    --n;
+
+    if(depth == 0){					// the leaf is the root
+
+      if(l->count == 0){ clear(); }
+      return;
+    }
+
+    if(l->count >= min_leaf){ return; }
+
+    --depth;
+
+    bool shrunk{_fix_leaf(l, path[depth], path_index[depth])};
+
+    while(shrunk && depth > 0){
+
+      auto in = path[depth];
+
+      if(in->count >= min_inner){ break; }
+
+      --depth;
+      shrunk = _fix_inner(in, path[depth], path_index[depth]);
+    }
+
+    if(!root->leaf && root->count == 0){		// the root has a single child
+
+      auto old = static_cast<inner_type*>(root);
+      root = old->children[0];
+      delete old;
+    }
+  }
+
+
+  // ============================== PRINT ==============================
+  //
+  // Prints the content of every node of the tree, level by level from the
+  // root to the leaves.
+
+  void print() const{
+
+    std::size_t level{0};
+
+    // all the leaves are at the same depth: the levels are counted along
+    // the leftmost path
+    for(const node_type* tmp{root}; tmp; ++level){
+
+      std::cout << "\nLevel " << level << ":\n";
+
+      _print_level(root, level, 0);
+
+      tmp = tmp->leaf ? nullptr : static_cast<const inner_type*>(tmp)->children[0];
+    }
+  }
+
+  private:
+
+  // prints the nodes at the given depth of the subtree rooted in x
+  void _print_level(const node_type* x, std::size_t level, std::size_t depth) const{
+
+    if(depth < level){
+
+      auto in = static_cast<const inner_type*>(x);
+
+      for(unsigned i{0}; i <= in->count; ++i){ _print_level(in->children[i], level, depth+1); }
+
+      return;
+    }
+
+    std::cout << "[ ";
+
+    if(x->leaf){
+
+      auto l = static_cast<const leaf_type*>(x);
+
+      for(unsigned i{0}; i < l->count; ++i){ std::cout << l->keys[i] << ":" << l->values[i] << " "; }
+
+    }else{
+
+      for(unsigned i{0}; i < x->count; ++i){ std::cout << x->keys[i] << " "; }
+    }
+
+    std::cout << "]\n";
+  }
+};
+
+#endif
@@ -0,0 +1,690 @@
+#ifndef compact_hpp
+#define compact_hpp
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+// ============================ VALUE LAYOUTS ============================
+//
+// Tags selecting where a compact tree keeps its values.
+// With inline_values (the default) each value sits in its node, next to
+// the key. With separate_values the nodes hold only the links and the
+// key, and the values live in a vector of their own, at the same
+// positions as their nodes: a look-up reads only the small nodes on its
+// way down and touches a value only once it has found the key, which
+// keeps large values from filling the cache with bytes no comparison
+// needs.
+
+struct inline_values {};
+
+struct separate_values {};
+
+
+// ============================ COMPACT NODE =============================
+//
+// Node of a compact tree, stored by value in a vector together with all
+// the others. The children are 32-bit indices into the vector instead of
+// pointers, counted from 1 so that 0 stands for no child, and there is
+// no link to the parent: for <int, int> pairs a node takes 20 bytes
+// instead of the 40 of a bst node, with no allocation of its own. With
+// separate_values the node has no value, V being void.
+
+template<typename K, typename V>
+struct _compact_node{
+
+  std::uint32_t left;		// index of the left child, 0 if none
+
+  std::uint32_t right;		// index of the right child, 0 if none
+
+  unsigned char height;		// height of the subtree, 1 for a leaf
+
+  K key;			// key
+
+  V value;			// value
+
+  // ctor for a leaf
+  template<typename KK, typename... Types>
+  _compact_node(KK&& k, Types&&... args):
+    left{0}, right{0}, height{1}, key(std::forward<KK>(k)), value(std::forward<Types>(args)...) {}
+};
+
+template<typename K>
+struct _compact_node<K, void>{
+
+  std::uint32_t left;		// index of the left child, 0 if none
+
+  std::uint32_t right;		// index of the right child, 0 if none
+
+  unsigned char height;		// height of the subtree, 1 for a leaf
+
+  K key;			// key
+
+  // ctor for a leaf
+  template<typename KK>
+  explicit _compact_node(KK&& k): left{0}, right{0}, height{1}, key(std::forward<KK>(k)) {}
+};
+
+
+// ========================= COMPACT ITERATOR ============================
+//
+// Forward iterator over a compact tree. Without parent links the way
+// back up is kept in the iterator, as in the persistent tree: a stack of
+// the indices of the nodes whose left subtree is being visited, the
+// current one on top. An AVL tree of fewer than 2^32 nodes is less than
+// 47 levels high, so 48 entries are always enough. Keys and values are
+// stored apart, as in the frozen tree, so the iterator gives back a pair
+// of references to them; the value can be changed through an iterator,
+// the key cannot.
+
+template<typename T, typename P>
+class _compact_iterator{
+
+  static constexpr std::size_t max_height{48};
+
+  T* tree;					// tree the iterator belongs to
+
+  std::array<std::uint32_t, max_height> stack;	// pending ancestors, current node on top
+
+  std::size_t depth;				// number of nodes in the stack, 0 for end()
+
+  // pushes i and the nodes down its left spine
+  void _descend(std::uint32_t i) noexcept{
+
+    for(; i; i = tree->_at(i).left){ stack[depth++] = i; }
+  }
+
+  // helper returned by the arrow operator
+  struct arrow{
+
+    P pair;
+    const P* operator->() const noexcept{ return &pair; }
+  };
+
+  template<typename key_type, typename value_type, typename comparison_type, typename allocator_type, typename value_layout>
+  friend class compact_bst;
+
+  public:
+  using value_type = P;
+  using reference = P;
+  using pointer = arrow;
+  using difference_type = std::ptrdiff_t;
+  using iterator_category = std::forward_iterator_tag;
+
+  explicit _compact_iterator(T* t = nullptr) noexcept: tree{t}, depth{0} {}
+
+  reference operator*() const noexcept{
+
+    std::uint32_t i{stack[depth-1]};
+    return reference{tree->_at(i).key, tree->_value(i)};
+  }
+
+  pointer operator->() const noexcept{ return arrow{**this}; }
+
+  _compact_iterator& operator++() noexcept{
+
+    std::uint32_t i{stack[--depth]};
+    _descend(tree->_at(i).right);
+
+    return *this;
+  }
+
+  _compact_iterator operator++(int) noexcept{
+
+    auto tmp{*this};
+    ++(*this);
+    return tmp;
+  }
+
+  friend bool operator==(const _compact_iterator& a, const _compact_iterator& b) noexcept{
+
+    return a.depth == b.depth && (a.depth == 0 || a.stack[a.depth-1] == b.stack[b.depth-1]);
+  }
+
+  friend bool operator!=(const _compact_iterator& a, const _compact_iterator& b) noexcept{ return !(a == b); }
+};
+
+
+// ============================ COMPACT BST ==============================
+//
+// Binary search tree whose nodes live side by side in a single vector
+// and point to each other with 32-bit indices, for a smaller footprint
+// and better cache residency than the one allocation per node of bst: a
+// tree of n nodes takes n * sizeof(node) bytes, plus the spare capacity
+// of the vector, which reserve() and shrink_to_fit() control. With no
+// parent link the tree is kept balanced with the AVL rules, which are
+// applied on the way back up of the recursive insert and erase. A new
+// node is appended to the vector; erasing one moves the last node of the
+// vector into the hole it leaves, after looking up the link pointing to
+// it, so that the vector never has gaps. Since the vector may move its
+// nodes, insertions and erasures invalidate iterators and references to
+// the pairs, as those of std::vector do. Keys and values must be move
+// assignable, and the comparison operator must not throw while erasing.
+// The value layout (see above) tells whether the values are kept in the
+// nodes or in a parallel vector; the interface is the same.
+
+template<typename key_type, typename value_type, typename comparison_type = std::less<key_type>,
+         typename allocator_type = std::allocator<std::pair<const key_type, value_type>>,
+         typename value_layout = inline_values >
+class compact_bst{
+
+  public:
+  using pair_type = std::pair<const key_type, value_type>;
+
+  private:
+  static constexpr bool separate{std::is_same<value_layout, separate_values>::value};
+
+  using node_type = _compact_node<key_type, typename std::conditional<separate, void, value_type>::type>;
+  using node_allocator = typename std::allocator_traits<allocator_type>::template rebind_alloc<node_type>;
+  using value_allocator = typename std::allocator_traits<allocator_type>::template rebind_alloc<value_type>;
+
+  public:
+  using iterator = _compact_iterator<compact_bst, std::pair<const key_type&, value_type&>>;
+  using const_iterator = _compact_iterator<const compact_bst, std::pair<const key_type&, const value_type&>>;
+
+  private:
+  comparison_type op;				// comparison operator
+
+  std::vector<node_type, node_allocator> nodes;	// the nodes, node i at position i-1
+
+  std::vector<value_type, value_allocator> values;	// with separate_values, the value of node i at position i-1
+
+  std::uint32_t root;				// index of the root, 0 if empty
+
+  template<typename T, typename P>
+  friend class _compact_iterator;
+
+  node_type& _at(std::uint32_t i) noexcept{ return nodes[i-1]; }
+
+  const node_type& _at(std::uint32_t i) const noexcept{ return nodes[i-1]; }
+
+  value_type& _value(std::uint32_t i) noexcept{
+
+    if constexpr(separate){ return values[i-1]; }
+    else{ return _at(i).value; }
+  }
+
+  const value_type& _value(std::uint32_t i) const noexcept{
+
+    if constexpr(separate){ return values[i-1]; }
+    else{ return _at(i).value; }
+  }
+
+  unsigned char _height(std::uint32_t i) const noexcept{ return i ? _at(i).height : 0; }
+
+  // appends a leaf with key k and value built out of args; with
+  // separate_values the value goes first, and is dropped if the node
+  // cannot be appended
+  template<typename KK, typename... Types>
+  void _append(KK&& k, Types&&... args){
+
+    if constexpr(separate){
+
+      values.emplace_back(std::forward<Types>(args)...);
+
+      try{
+	nodes.emplace_back(std::forward<KK>(k));
+
+      }catch(...){ values.pop_back(); throw; }
+
+    }else{
+
+      nodes.emplace_back(std::forward<KK>(k), std::forward<Types>(args)...);
+    }
+  }
+
+  void _update(std::uint32_t i) noexcept{
+
+    auto& n = _at(i);
+    n.height = 1 + std::max(_height(n.left), _height(n.right));
+  }
+
+  //============================= _ROTATE ===============================
+  //
+  // Private auxiliary functions that rotate the subtree rooted in i to
+  // the left or to the right, returning the index of its new root.
+
+  std::uint32_t _rotate_left(std::uint32_t i) noexcept{
+
+    std::uint32_t r{_at(i).right};
+
+    _at(i).right = _at(r).left;
+    _at(r).left = i;
+    _update(i);
+    _update(r);
+
+    return r;
+  }
+
+  std::uint32_t _rotate_right(std::uint32_t i) noexcept{
+
+    std::uint32_t l{_at(i).left};
+
+    _at(i).left = _at(l).right;
+    _at(l).right = i;
+    _update(i);
+    _update(l);
+
+    return l;
+  }
+
+  //============================= _BALANCE ==============================
+  //
+  // A private auxiliary function that restores the AVL rule in node i,
+  // whose subtrees may differ in height by two, by rotating the higher
+  // one up (twice if its inner subtree is the higher one), and returns
+  // the index of the new root of the subtree.
+
+  std::uint32_t _balance(std::uint32_t i) noexcept{
+
+    std::uint32_t l{_at(i).left}, r{_at(i).right};
+
+    if(_height(l) > _height(r) + 1){
+
+      if(_height(_at(l).left) < _height(_at(l).right)){ _at(i).left = _rotate_left(l); }
+
+      return _rotate_right(i);
+    }
+
+    if(_height(r) > _height(l) + 1){
+
+      if(_height(_at(r).right) < _height(_at(r).left)){ _at(i).right = _rotate_right(r); }
+
+      return _rotate_left(i);
+    }
+
+    _update(i);
+    return i;
+  }
+
+  //============================== _INSERT ==============================
+  //
+  // A private auxiliary function that inserts a node built out of args
+  // in the subtree rooted in i, if the key x is not there, and returns
+  // the index of the new root of the subtree. pos is set to the index of
+  // the node with key x and grown to whether the subtree has grown
+  // higher: once a subtree keeps its height the nodes above it keep
+  // theirs, and are neither rebalanced nor written on the way back up,
+  // which spares reading the heights of their other children. Nothing
+  // is changed on the way down, so if the node cannot be built the tree
+  // is left as it was.
+
+  template<typename K, typename... Types>
+  std::uint32_t _insert(std::uint32_t i, const K& x, std::uint32_t& pos, bool& grown, Types&&... args){
+
+    if(!i){
+
+      if(nodes.size() == std::numeric_limits<std::uint32_t>::max()){ throw std::length_error{"compact_bst: too many nodes"}; }
+
+      _append(std::forward<Types>(args)...);
+      pos = nodes.size();
+      grown = true;
+
+      return pos;
+    }
+
+    const unsigned char h{_at(i).height};
+
+    if(op(x, _at(i).key)){
+
+      std::uint32_t l{_insert(_at(i).left, x, pos, grown, std::forward<Types>(args)...)};
+      _at(i).left = l;
+
+    }else if(op(_at(i).key, x)){
+
+      std::uint32_t r{_insert(_at(i).right, x, pos, grown, std::forward<Types>(args)...)};
+      _at(i).right = r;
+
+    }else{
+
+      pos = i;
+      grown = false;
+    }
+
+    if(!grown){ return i; }
+
+    i = _balance(i);
+    grown = _at(i).height != h;
+
+    return i;
+  }
+
+  // inserts a node built out of args if the key x is not there, and
+  // returns the index of the node with key x
+  template<typename K, typename... Types>
+  std::uint32_t _insert_root(const K& x, bool& inserted, Types&&... args){
+
+    const std::size_t n{nodes.size()};
+    std::uint32_t pos;
+    bool grown;
+
+    root = _insert(root, x, pos, grown, std::forward<Types>(args)...);
+    inserted = nodes.size() != n;
+
+    return pos;
+  }
+
+  //============================== _ERASE ===============================
+  //
+  // Private auxiliary functions that unlink the node with key x from the
+  // subtree rooted in i, setting removed to its index (or leaving it at
+  // 0 if x is not there), and return the index of the new root of the
+  // subtree. As in _insert, shrunk tells whether the subtree has become
+  // lower, and the nodes above one that has not are left alone. A node
+  // with two children is replaced by its successor, unlinked from the
+  // right subtree by _erase_min: the nodes are moved around by their
+  // links, the pairs stay where they are.
+
+  // rebalances i, whose subtree was h high, if one of its children has
+  // become lower
+  std::uint32_t _shrink(std::uint32_t i, unsigned char h, bool& shrunk) noexcept{
+
+    if(!shrunk){ return i; }
+
+    i = _balance(i);
+    shrunk = _at(i).height != h;
+
+    return i;
+  }
+
+  std::uint32_t _erase_min(std::uint32_t i, std::uint32_t& min, bool& shrunk) noexcept{
+
+    if(!_at(i).left){
+
+      min = i;
+      shrunk = true;
+
+      return _at(i).right;
+    }
+
+    const unsigned char h{_at(i).height};
+
+    _at(i).left = _erase_min(_at(i).left, min, shrunk);
+
+    return _shrink(i, h, shrunk);
+  }
+
+  template<typename K>
+  std::uint32_t _erase(std::uint32_t i, const K& x, std::uint32_t& removed, bool& shrunk){
+
+    if(!i){
+
+      shrunk = false;
+      return 0;
+    }
+
+    const unsigned char h{_at(i).height};
+
+    if(op(x, _at(i).key)){
+
+      _at(i).left = _erase(_at(i).left, x, removed, shrunk);
+
+    }else if(op(_at(i).key, x)){
+
+      _at(i).right = _erase(_at(i).right, x, removed, shrunk);
+
+    }else{
+
+      removed = i;
+
+      std::uint32_t l{_at(i).left}, r{_at(i).right};
+
+      if(!l || !r){
+
+	shrunk = true;
+	return l ? l : r;
+      }
+
+      std::uint32_t min;
+      r = _erase_min(r, min, shrunk);
+
+      _at(min).left = l;
+      _at(min).right = r;
+      _at(min).height = h;
+
+      i = min;
+    }
+
+    return _shrink(i, h, shrunk);
+  }
+
+  //============================== _FILL ================================
+  //
+  // A private auxiliary function that fills the hole left in the vector
+  // by the unlinked node i with the last node, found by looking up its
+  // key, and then drops the last position (of both vectors, with
+  // separate_values).
+
+  void _fill(std::uint32_t i){
+
+    std::uint32_t last = nodes.size();
+
+    if(i != last){
+
+      const key_type& x{_at(last).key};
+      std::uint32_t* link{&root};
+
+      while(*link != last){ link = op(x, _at(*link).key) ? &_at(*link).left : &_at(*link).right; }
+
+      *link = i;
+      _at(i) = std::move(_at(last));
+
+      if constexpr(separate){ values[i-1] = std::move(values[last-1]); }
+    }
+
+    nodes.pop_back();
+
+    if constexpr(separate){ values.pop_back(); }
+  }
+
+  // fills the stack of it with the path to the first key not less than x
+  template<typename I, typename K>
+  I _lower_bound(I it, const K& x) const{
+
+    for(std::uint32_t n{root}; n; ){
+
+      if(op(_at(n).key, x)){ n = _at(n).right; }
+      else{ it.stack[it.depth++] = n; n = _at(n).left; }
+    }
+
+    return it;
+  }
+
+  // the same down to the key x, stopping there, or end()
+  template<typename I, typename K>
+  I _find(I it, const K& x) const{
+
+    for(std::uint32_t n{root}; n; ){
+
+      if(op(x, _at(n).key)){ it.stack[it.depth++] = n; n = _at(n).left; }
+      else if(op(_at(n).key, x)){ n = _at(n).right; }
+      else{ it.stack[it.depth++] = n; return it; }
+    }
+
+    return I{it.tree};
+  }
+
+
+  public:
+  // ctor for an empty tree
+  compact_bst(): op{}, nodes{}, values{}, root{0} {}
+
+  explicit compact_bst(comparison_type comp, const allocator_type& a = allocator_type{}):
+    op{comp}, nodes(node_allocator(a)), values(value_allocator(a)), root{0} {}
+
+  compact_bst(const compact_bst&) = default;
+  compact_bst& operator=(const compact_bst&) = default;
+
+  // moves leave x empty: the root is an index, not a pointer, so it has
+  // to be reset together with the vectors
+
+  compact_bst(compact_bst&& x) noexcept:
+    op{std::move(x.op)}, nodes(std::move(x.nodes)), values(std::move(x.values)), root{x.root} {
+
+    x.nodes.clear();
+    x.values.clear();
+    x.root = 0;
+  }
+
+  compact_bst& operator=(compact_bst&& x)
+    noexcept(std::is_nothrow_move_assignable<std::vector<node_type, node_allocator>>::value
+             && std::is_nothrow_move_assignable<std::vector<value_type, value_allocator>>::value){
+
+    if(this != &x){
+
+      op = std::move(x.op);
+      nodes = std::move(x.nodes);
+      values = std::move(x.values);
+      root = x.root;
+      x.nodes.clear();
+      x.values.clear();
+      x.root = 0;
+    }
+
+    return *this;
+  }
+
+
+  // ============================== INSERT ==============================
+  //
+  // Inserts a pair if its key is not there yet and returns whether it
+  // has been inserted. emplace() takes the key and the arguments of the
+  // value. The subscript operator inserts a default value if the key is
+  // not there.
+
+  bool insert(const pair_type& x){
+
+    bool inserted;
+    _insert_root(x.first, inserted, x.first, x.second);
+    return inserted;
+  }
+
+  bool insert(pair_type&& x){
+
+    bool inserted;
+    _insert_root(x.first, inserted, x.first, std::move(x.second));
+    return inserted;
+  }
+
+  template<typename... Types>
+  bool emplace(const key_type& k, Types&&... args){
+
+    bool inserted;
+    _insert_root(k, inserted, k, std::forward<Types>(args)...);
+    return inserted;
+  }
+
+  value_type& operator[](const key_type& k){
+
+    bool inserted;
+    return _value(_insert_root(k, inserted, k));
+  }
+
+
+  // ============================== ERASE ===============================
+  //
+  // Removes the pair with key x, if any, and returns how many pairs have
+  // been removed.
+
+  std::size_t erase(const key_type& x){
+
+    std::uint32_t removed{0};
+    bool shrunk;
+
+    root = _erase(root, x, removed, shrunk);
+
+    if(!removed){ return 0; }
+
+    _fill(removed);
+    return 1;
+  }
+
+  void clear() noexcept{
+
+    nodes.clear();
+    values.clear();
+    root = 0;
+  }
+
+
+  // ============================== LOOK-UP =============================
+  //
+  // find() returns an iterator to the pair with key x, or end();
+  // lower_bound() to the first pair whose key is not less than x. The
+  // iterator keeps the nodes it goes through in its stack.
+
+  iterator find(const key_type& x){ return _find(iterator{this}, x); }
+
+  const_iterator find(const key_type& x) const{ return _find(const_iterator{this}, x); }
+
+  iterator lower_bound(const key_type& x){ return _lower_bound(iterator{this}, x); }
+
+  const_iterator lower_bound(const key_type& x) const{ return _lower_bound(const_iterator{this}, x); }
+
+  std::size_t count(const key_type& x) const{ return find(x) != end() ? 1 : 0; }
+
+  // ========================== BEGIN and END ==========================
+
+  iterator begin() noexcept{ iterator it{this}; it._descend(root); return it; }
+
+  const_iterator begin() const noexcept{ const_iterator it{this}; it._descend(root); return it; }
+
+  const_iterator cbegin() const noexcept{ return begin(); }
+
+  iterator end() noexcept{ return iterator{this}; }
+
+  const_iterator end() const noexcept{ return const_iterator{this}; }
+
+  const_iterator cend() const noexcept{ return end(); }
+
+  // ============================== SIZE ===============================
+
+  std::size_t size() const noexcept{ return nodes.size(); }
+
+  bool empty() const noexcept{ return nodes.empty(); }
+
+  // height of the tree, 0 if empty
+  std::size_t height() const noexcept{ return _height(root); }
+
+  // room for n nodes without moving them, and release of the spare room
+  void reserve(std::size_t n){
+
+    nodes.reserve(n);
+
+    if constexpr(separate){ values.reserve(n); }
+  }
+
+  void shrink_to_fit(){
+
+    nodes.shrink_to_fit();
+    values.shrink_to_fit();
+  }
+
+  allocator_type get_allocator() const{ return allocator_type(nodes.get_allocator()); }
+
+
+  // ========================= PUT TO OPERATOR ==========================
+  //
+  // Prints the key-value pairs in order.
+
+  friend std::ostream& operator<<(std::ostream& os, const compact_bst& x){
+
+    for(const auto& i : x){ os << i.first << ":" << i.second << " "; }
+
+    return os;
+  }
+
+};
+
+#endif
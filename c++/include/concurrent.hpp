@@ -0,0 +1,210 @@
+#ifndef concurrent_hpp
+#define concurrent_hpp
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include "bst.hpp"
+
+
+// ========================== BIG READER LOCK ============================
+//
+// Reader-writer lock for read-mostly data. A reader announces itself in
+// one of `_slots` counters, picked by a per-thread index, each in a cache
+// line of its own: threads with different slots never write to the same
+// line, so readers do not slow each other down as they would with a
+// single shared counter. A writer first takes the writers' mutex, then
+// raises the `writing` flag and waits for every counter to drop to 0. A
+// reader that finds the flag raised after announcing itself withdraws
+// and waits for the writer to finish, so writers are not starved. Both
+// sides write their own variable and then read the other's with
+// sequentially consistent operations, so at least one of them sees the
+// other. The read lock is not recursive: a thread holding it must not
+// take it again, or it may wait forever for a writer waiting for it.
+
+class _big_reader_lock{
+
+  static constexpr std::size_t _slots{64};
+
+  struct alignas(64) _slot{ std::atomic<std::size_t> readers{0}; };
+
+  std::unique_ptr<_slot[]> slots;	// reader counters, one cache line each
+
+  alignas(64) std::atomic<bool> writing;	// raised while a writer is in
+
+  std::mutex writers;			// serialises the writers
+
+  // index of the calling thread, given once per thread
+  static std::size_t _thread_index() noexcept{
+
+    static std::atomic<std::size_t> next{0};
+    thread_local const std::size_t index{next++};
+
+    return index;
+  }
+
+  public:
+  _big_reader_lock(): slots{new _slot[_slots]}, writing{false} {}
+
+  _big_reader_lock(const _big_reader_lock&) = delete;
+  _big_reader_lock& operator=(const _big_reader_lock&) = delete;
+
+  // returns the slot to be given back to unlock_shared()
+  std::size_t lock_shared() noexcept{
+
+    const std::size_t s{_thread_index() % _slots};
+
+    for(;;){
+
+      slots[s].readers.fetch_add(1);
+
+      if(!writing.load()){ return s; }
+
+      slots[s].readers.fetch_sub(1, std::memory_order_release);
+
+      while(writing.load(std::memory_order_relaxed)){ std::this_thread::yield(); }
+    }
+  }
+
+  void unlock_shared(std::size_t s) noexcept{ slots[s].readers.fetch_sub(1, std::memory_order_release); }
+
+  void lock(){
+
+    writers.lock();
+    writing.store(true);
+
+    for(std::size_t s{0}; s < _slots; ++s){
+
+      while(slots[s].readers.load() != 0){ std::this_thread::yield(); }
+    }
+  }
+
+  void unlock() noexcept{
+
+    writing.store(false, std::memory_order_release);
+    writers.unlock();
+  }
+};
+
+
+// =========================== CONCURRENT BST ============================
+//
+// Thread-safe binary search tree for read-mostly workloads: any number of
+// threads can look up keys and visit the tree at the same time without
+// blocking each other, while insertions and erasures are run one at a
+// time, with the readers kept out by a big reader lock. Since no reader
+// is inside while a writer runs, erased nodes are given back to the
+// allocator at once. Iterators cannot outlive a lock, so look-ups return
+// a copy of the value and visits are done through functions called with
+// the lock held; those functions must not call back into the tree. The
+// tree is red-black by default, since nobody can call balance() while
+// the tree is shared.
+
+template<typename key_type, typename value_type, typename comparison_type = std::less<key_type>,
+         typename allocator_type = std::allocator<std::pair<const key_type, value_type>>,
+         typename balancing_policy = red_black_balancing >
+class concurrent_bst{
+
+  public:
+  using tree_type = bst<key_type, value_type, comparison_type, allocator_type, balancing_policy>;
+  using pair_type = typename tree_type::pair_type;
+
+  private:
+  tree_type tree;			// the shared tree
+
+  mutable _big_reader_lock lock;	// guards the tree
+
+  // calls f with the read lock held
+  template<typename F>
+  auto _read(F&& f) const{
+
+    struct guard{
+
+      _big_reader_lock& l;
+      std::size_t s;
+
+      ~guard(){ l.unlock_shared(s); }
+
+    } g{lock, lock.lock_shared()};
+
+    return f(static_cast<const tree_type&>(tree));
+  }
+
+  public:
+  // ctor for an empty tree
+  concurrent_bst() = default;
+
+  explicit concurrent_bst(comparison_type comp, const allocator_type& a = allocator_type{}): tree{comp, a} {}
+
+  // ctor sharing an existing tree, which is moved in
+  explicit concurrent_bst(tree_type&& t): tree{std::move(t)} {}
+
+  concurrent_bst(const concurrent_bst&) = delete;
+  concurrent_bst& operator=(const concurrent_bst&) = delete;
+
+
+  // =============================== READ ===============================
+  //
+  // Look-ups, run concurrently with each other. find() returns a copy of
+  // the value with key x, if any. read() calls f with a const reference
+  // to the tree and returns its result, for any other query; for_each()
+  // calls f on every pair in order.
+
+  std::optional<value_type> find(const key_type& x) const{
+
+    return _read([&x](const tree_type& t){
+
+      auto it = t.find(x);
+      return it == t.cend() ? std::optional<value_type>{} : std::optional<value_type>{it->second};
+    });
+  }
+
+  bool contains(const key_type& x) const{ return _read([&x](const tree_type& t){ return t.find(x) != t.cend(); }); }
+
+  std::size_t size() const{ return _read([](const tree_type& t){ return t.size(); }); }
+
+  bool empty() const{ return size() == 0; }
+
+  template<typename F>
+  auto read(F&& f) const{ return _read(std::forward<F>(f)); }
+
+  template<typename F>
+  void for_each(F&& f) const{ _read([&f](const tree_type& t){ for(const auto& i : t){ f(i); } }); }
+
+
+  // =============================== WRITE ==============================
+  //
+  // Modifications, run one at a time with no reader inside. insert() and
+  // emplace() return whether the pair has been inserted, erase() whether
+  // a pair has been removed. write() calls f with a reference to the tree
+  // and returns its result, for any other modification.
+
+  template<typename F>
+  auto write(F&& f){
+
+    std::lock_guard<_big_reader_lock> g{lock};
+
+    return f(tree);
+  }
+
+  bool insert(const pair_type& x){ return write([&x](tree_type& t){ return t.insert(x).second; }); }
+
+  bool insert(pair_type&& x){ return write([&x](tree_type& t){ return t.insert(std::move(x)).second; }); }
+
+  template<typename... Types>
+  bool emplace(Types&&... args){
+
+    return write([&](tree_type& t){ return t.emplace(std::forward<Types>(args)...).second; });
+  }
+
+  bool erase(const key_type& x){ return write([&x](tree_type& t){ return !t.extract(x).empty(); }); }
+
+  void clear(){ write([](tree_type& t){ t.clear(); }); }
+};
+
+#endif
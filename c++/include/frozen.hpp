@@ -0,0 +1,319 @@
+#ifndef frozen_hpp
+#define frozen_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+
+template<typename F>
+class _frozen_iterator;
+
+template<typename key_type, typename value_type, typename comparison_type>
+class mapped_bst;
+
+
+// ========================== EYTZINGER ORDER ============================
+//
+// Free helpers on the n keys stored from position 1 of an array in
+// Eytzinger order, shared by frozen_bst and mapped_bst.
+// _eytzinger_search goes down the implicit tree, turning right where
+// right(key) holds and left otherwise, and returns the last node where
+// it turned left, or 0: with right(key) = key < x this is the first key
+// not less than x. Once k has gone past the last level the trailing
+// right turns (the ones in the binary representation of k) and the last
+// left turn are undone by _eytzinger_up, which climbs the implicit tree
+// from k while k is a right child, and then one more level. Each step
+// prefetches the cache line holding the nodes a few levels below.
+// _eytzinger_first returns the leftmost position of the subtree rooted
+// in k, or 0 if there is none.
+
+inline std::size_t _eytzinger_up(std::size_t k) noexcept{
+
+  while(k & 1){ k >>= 1; }
+
+  return k >> 1;
+}
+
+template<typename K, typename P>
+std::size_t _eytzinger_search(const K* base, std::size_t n, P right) noexcept{
+
+  // number of keys in a cache line: prefetching position k*stride loads
+  // the descendants of k a few levels below
+  constexpr std::size_t stride{sizeof(K) < 64 ? 64/sizeof(K) : 1};
+
+  std::size_t k{1};
+
+  while(k <= n){
+
+#if defined(__GNUC__)
+    __builtin_prefetch(reinterpret_cast<const void*>(reinterpret_cast<std::uintptr_t>(base) + k*stride*sizeof(K)));
+#endif
+    k = 2*k + static_cast<std::size_t>(right(base[k]));
+  }
+
+  return _eytzinger_up(k);
+}
+
+inline std::size_t _eytzinger_first(std::size_t k, std::size_t n) noexcept{
+
+  if(k > n){ return 0; }
+
+  while(2*k <= n){ k = 2*k; }
+
+  return k;
+}
+
+
+// ============================ FROZEN BST ===============================
+//
+// Read-only snapshot of a binary search tree, obtained through
+// bst::freeze() (or directly from a sorted range of pairs).
+// The keys are stored in a contiguous array in Eytzinger order, i.e. the
+// order of a breadth-first visit of a perfectly balanced tree: the root
+// is in position 1 and the children of the node in position k are in
+// positions 2k and 2k+1. The values are stored in a parallel array and
+// are touched only once the key has been found.
+// A search goes down the implicit tree computing the next position with
+// arithmetic instead of a branch, and prefetches the cache line holding
+// the nodes a few levels below, so that the look-up is limited by the
+// memory bandwidth rather than by the latency of each access.
+
+template<typename key_type, typename value_type, typename comparison_type = std::less<key_type> >
+class frozen_bst{
+
+  comparison_type op;			// comparison operator
+
+  std::vector<key_type> keys;		// keys in Eytzinger order, position 0 unused
+
+  std::vector<value_type> values;	// values, parallel to keys
+
+  std::size_t n;			// number of pairs
+
+  //============================== _FILL ===============================
+  //
+  // A private auxiliary function that fills the subtree rooted in
+  // position k with the next pairs of a sorted sequence, through an
+  // in-order visit of the implicit tree.
+
+  template<typename I>
+  void _fill(I& it, std::size_t k){
+
+    if(k > n){ return; }
+
+    _fill(it, 2*k);
+
+    keys[k] = (*it).first;
+    values[k] = (*it).second;
+    ++it;
+
+    _fill(it, 2*k+1);
+  }
+
+  //========================== _LOWER_BOUND ============================
+  //
+  // A private auxiliary function that returns the position of the first
+  // key not less than x, or 0 if there is none (see _eytzinger_search).
+
+  template<typename K>
+  std::size_t _lower_bound(const K& x) const noexcept{
+
+    return _eytzinger_search(keys.data(), n, [this, &x](const key_type& key){ return op(key, x); });
+  }
+
+  //=============================== _FIND ==============================
+  //
+  // A private auxiliary function that returns the position of the key x,
+  // or 0 if it is not present.
+
+  template<typename K>
+  std::size_t _find(const K& x) const noexcept{
+
+    std::size_t k{_lower_bound(x)};
+
+    return (k && !op(x, keys[k])) ? k : 0;
+  }
+
+  //================================ _UP ===============================
+  //
+  // A private auxiliary function that climbs the implicit tree from
+  // position k while k is a right child, and then one more level.
+
+  static std::size_t _up(std::size_t k) noexcept{ return _eytzinger_up(k); }
+
+  //============================== _FIRST ==============================
+  //
+  // A private auxiliary function returning the leftmost position of the
+  // subtree rooted in k.
+
+  std::size_t _first(std::size_t k) const noexcept{ return _eytzinger_first(k, n); }
+
+  template<typename F>
+  friend class _frozen_iterator;
+
+  // writes the arrays of a snapshot to a file
+  friend class mapped_bst<key_type, value_type, comparison_type>;
+
+  public:
+  using pair_type = typename std::pair<const key_type&, const value_type&>;
+
+  using const_iterator = _frozen_iterator<frozen_bst>;
+  using iterator = const_iterator;
+
+  // ctor for an empty snapshot
+
+  frozen_bst(): op{}, keys(1), values(1), n{0} {}
+
+  // ctor from the n pairs of a sorted range without duplicate keys,
+  // which are read once and in order
+
+  template<typename I>
+  frozen_bst(I first, std::size_t size, comparison_type comp = comparison_type{}):
+    op{comp}, keys(size+1), values(size+1), n{size} {
+
+    _fill(first, 1);
+  }
+
+  // ============================== FIND ==============================
+  //
+  // Finds the pair with the given key, returning end() if it is not
+  // present.
+
+  const_iterator find(const key_type& x) const noexcept{ return const_iterator{this, _find(x)}; }
+
+  // with a transparent comparison operator any type comparable with the
+  // keys can be looked for, without building a temporary key_type
+
+  template<typename K, typename C = comparison_type, typename = typename C::is_transparent>
+  const_iterator find(const K& x) const noexcept{ return const_iterator{this, _find(x)}; }
+
+  // =========================== LOWER BOUND ===========================
+  //
+  // Returns an iterator to the first pair whose key is not less than x,
+  // or end() if there is none.
+
+  const_iterator lower_bound(const key_type& x) const noexcept{ return const_iterator{this, _lower_bound(x)}; }
+
+  template<typename K, typename C = comparison_type, typename = typename C::is_transparent>
+  const_iterator lower_bound(const K& x) const noexcept{ return const_iterator{this, _lower_bound(x)}; }
+
+  // ============================== COUNT ==============================
+  //
+  // Returns 1 if the key is present and 0 otherwise.
+
+  std::size_t count(const key_type& x) const noexcept{ return _find(x) ? 1 : 0; }
+
+  template<typename K, typename C = comparison_type, typename = typename C::is_transparent>
+  std::size_t count(const K& x) const noexcept{ return _find(x) ? 1 : 0; }
+
+  // ========================== BEGIN and END ==========================
+
+  const_iterator begin() const noexcept{ return const_iterator{this, _first(1)}; }
+  const_iterator cbegin() const noexcept{ return begin(); }
+
+  const_iterator end() const noexcept{ return const_iterator{this, 0}; }
+  const_iterator cend() const noexcept{ return end(); }
+
+  // ============================== SIZE ===============================
+
+  std::size_t size() const noexcept{ return n; }
+
+  bool empty() const noexcept{ return n == 0; }
+
+  // ========================= PUT TO OPERATOR =========================
+  //
+  // Prints keys and values from the smallest to the largest key.
+
+  friend
+  std::ostream& operator<<(std::ostream& os, const frozen_bst& x){
+
+    os << "Key:\t" << "Value:\n";
+
+    for(const auto& i : x){
+
+      os << i.first  << "   \t" << i.second << "\n";
+    }
+
+    return os;
+  }
+};
+
+
+// ========================== FROZEN ITERATOR ============================
+//
+// Forward iterator visiting the pairs of a frozen_bst in increasing order
+// of the keys. The keys and values are stored apart, so the iterator
+// gives back a pair of references to them.
+
+template<typename F>
+class _frozen_iterator{
+
+  const F* tree;		// snapshot the iterator belongs to
+  std::size_t k;		// position, 0 for end()
+
+  // helper returned by the arrow operator
+  struct arrow{
+
+    typename F::pair_type pair;
+    const typename F::pair_type* operator->() const noexcept{ return &pair; }
+  };
+
+  public:
+  using value_type = typename F::pair_type;
+  using difference_type = std::ptrdiff_t;
+  using iterator_category = std::forward_iterator_tag;
+  using reference = value_type;
+  using pointer = arrow;
+
+  _frozen_iterator(const F* t, std::size_t i) noexcept: tree{t}, k{i} {}
+
+  // de-reference operator
+  reference operator*() const noexcept{ return reference{tree->keys[k], tree->values[k]}; }
+
+  // arrow operator
+  pointer operator->() const noexcept{ return arrow{*(*this)}; }
+
+  // pre increment operator: the leftmost node of the right subtree if
+  // it exists, otherwise the first ancestor we reach from its left
+  _frozen_iterator& operator++() noexcept{
+
+    if(2*k+1 <= tree->n){
+
+      k = tree->_first(2*k+1);
+
+    }else{
+
+      k = F::_up(k);
+    }
+
+    return *this;
+  }
+
+  // post increment
+  _frozen_iterator operator++(int) noexcept{
+
+    auto tmp{*this};
+    ++(*this);
+    return tmp;
+  }
+
+  // Equality operator
+  friend
+  bool operator==(const _frozen_iterator& a, const _frozen_iterator& b){
+
+    return a.k == b.k;
+  }
+
+  // Inequality operator
+  friend
+  bool operator!=(const _frozen_iterator& a, const _frozen_iterator& b){
+
+    return !(a==b);
+  }
+};
+
+#endif
@@ -1,96 +1,244 @@
 #ifndef iterator_hpp
 #define iterator_hpp
 
+#include <cstddef>
 #include <iterator>
+#include <type_traits>
 
-template<typename key_type, typename value_type, typename comparison_type>
+template<typename key_type, typename value_type, typename comparison_type, typename allocator_type, typename balancing_policy>
 class bst;
 
 
 // ============================== ITERATOR ===============================
 //
-// Class that implements the iterator for the binary search tree
+// Class that implements the bidirectional iterator for the binary search
+// tree. Besides the node it refers to, the iterator keeps the address of
+// the pointer to the rightmost node cached inside the tree, so that it
+// can step back from end().
 
 template<typename N, typename T>
 class _iterator{
 
   node<N>* current;		// node referred to by the iterator
 
+  node<N>* const* last;		// address of the rightmost node of the tree
+
   // standard members of an iterator
   public:
   using val_type = T;
+  using value_type = typename std::remove_const<T>::type;
   using difference_type = std::ptrdiff_t;
-  using iterator_category = std::forward_iterator_tag;
+  using iterator_category = std::bidirectional_iterator_tag;
   using reference = val_type&;
   using pointer = val_type*;
-  
+
   // de-reference operator
   reference operator*() const noexcept { return current->pair; }
 
   // arrow operator
   pointer operator->() const noexcept { return &(*(*this)); }
-  
+
   // pre increment  operator
   _iterator& operator++() noexcept{
-    
+
     if(!current){			// if current is nullptr return current
 
       return *this;
-    
+
     }else if(current->right){ 		// if current has a right child jump to it
-    
-      current = current ->right.get();
+
+      current = current ->right;
 
       while(current -> left){ 		// until we have a left child jump to it
 
-        current = current -> left.get();
+        current = current -> left;
       }
 
     }else{                    		// if current has not a right child go up
-      
+
       node<N>* up = current->parent;
-      while(up != nullptr && current == up->right.get()){ // go up until reaching a nullptr, stop if right child
-                                  
+      while(up != nullptr && current == up->right){ // go up until reaching a nullptr, stop if right child
+
         current = up;
         up = current->parent;
       }
 
     current = up;
     }
-    
+
     return *this;
   }
 
   // post increment
-  _iterator &operator++(int) noexcept {
-    
+  _iterator operator++(int) noexcept {
+
     auto tmp{*this};
     ++(*this);
     return tmp;
   }
 
+  // pre decrement operator, mirror image of the pre increment one;
+  // stepping back from end() leads to the rightmost node
+  _iterator& operator--() noexcept{
+
+    if(!current){			// from end() jump to the rightmost node
+
+      current = *last;
+
+    }else if(current->left){		// if current has a left child jump to it
+
+      current = current->left;
+
+      while(current->right){		// until we have a right child jump to it
+
+        current = current->right;
+      }
+
+    }else{				// if current has not a left child go up
+
+      node<N>* up = current->parent;
+      while(up != nullptr && current == up->left){ // go up until reaching a nullptr, stop if left child
+
+        current = up;
+        up = current->parent;
+      }
+
+      current = up;
+    }
+
+    return *this;
+  }
+
+  // post decrement
+  _iterator operator--(int) noexcept {
+
+    auto tmp{*this};
+    --(*this);
+    return tmp;
+  }
+
+
+  // ======================== ARITHMETIC BY RANK =========================
+  //
+  // Every node stores the size of its subtree, so the position (rank) of
+  // a node can be computed going up to the root, and the node in a given
+  // position going down from it, both in O(height): an iterator can be
+  // moved forward or backward by d positions, and the difference of two
+  // iterators of the same tree is the difference of their positions. The
+  // iterator stays bidirectional, since these are not O(1) operations.
+
+  private:
+
+  // size of the subtree rooted in n
+  static std::size_t _size(const node<N>* n) noexcept{ return n ? n->size : 0; }
+
+  // node with k nodes before it in the subtree rooted in n, nullptr if
+  // there are not enough nodes
+  static node<N>* _select(node<N>* n, std::size_t k) noexcept{
+
+    while(n){
+
+      std::size_t l{_size(n->left)};
+
+      if(k < l){ n = n->left; }
+      else if(k == l){ return n; }
+      else{
+
+        k -= l + 1;
+        n = n->right;
+      }
+    }
+
+    return nullptr;
+  }
+
+  // root of the tree, reached from the current node or from the rightmost
+  // one for end(); nullptr for an empty tree
+  node<N>* _root() const noexcept{
+
+    node<N>* n{current ? current : *last};
+
+    while(n && n->parent){ n = n->parent; }
+
+    return n;
+  }
+
+  // position of the current node, the size of the tree for end()
+  std::size_t _rank() const noexcept{
+
+    if(!current){ return _size(_root()); }
+
+    std::size_t r{_size(current->left)};
+
+    for(node<N>* n{current}; n->parent; n = n->parent){
+
+      if(n == n->parent->right){ r += _size(n->parent->left) + 1; }
+    }
+
+    return r;
+  }
+
+  public:
+
+  // a negative d moves backward: it is subtracted from the rank instead of
+  // being converted to an unsigned offset; as for end() + 1, moving out of
+  // the positions from begin() to end() leads to end()
+  _iterator& operator+=(difference_type d) noexcept{
+
+    std::size_t r{_rank()};
+    std::size_t step{d < 0 ? std::size_t(0) - static_cast<std::size_t>(d) : static_cast<std::size_t>(d)};
+
+    if(d < 0 && step > r){ current = nullptr; }
+    else{ current = _select(_root(), d < 0 ? r - step : r + step); }
+
+    return *this;
+  }
+
+  _iterator& operator-=(difference_type d) noexcept{ return *this += -d; }
+
+  friend _iterator operator+(_iterator a, difference_type d) noexcept{ return a += d; }
+  friend _iterator operator+(difference_type d, _iterator a) noexcept{ return a += d; }
+  friend _iterator operator-(_iterator a, difference_type d) noexcept{ return a -= d; }
+
+  friend difference_type operator-(const _iterator& a, const _iterator& b) noexcept{
+
+    return static_cast<difference_type>(a._rank()) - static_cast<difference_type>(b._rank());
+  }
+
+
+  // a default constructed iterator is singular, it can only be assigned
+  _iterator() noexcept: current{nullptr}, last{nullptr} {}
+
+  // construct an iterator given a pointer to a node and the address of
+  // the rightmost node of its tree
+  _iterator(node<N>* n, node<N>* const* l) noexcept: current{n}, last{l} {}
+
+  // a non-constant iterator can be converted to a constant one
+  template<typename TT, typename = typename std::enable_if<std::is_same<const TT, T>::value>::type>
+  _iterator(const _iterator<N, TT>& x) noexcept: current{x.current}, last{x.last} {}
 
-  // construct an iterator given a pointer to a node
-   explicit _iterator(node<N>* n): current{n} {}
-  
   // Equality operator
   friend
   bool operator==(const _iterator& a, const _iterator& b){
-    
+
     return a.current == b.current;
   }
-  
+
   // Inequality operator
   friend
   bool operator!=(const _iterator& a, const _iterator& b){
 
     return !(a==b);
   }
-  
+
+
+  // the other iterator type has to be a friend for the conversion
+  template<typename NN, typename TT>
+  friend class _iterator;
 
   // bst has to be a friend class in order to be able to access the private
   // members of the iterators
-  template<typename key_type, typename value_type, typename comparison_type>
+  template<typename key_type, typename value_type, typename comparison_type, typename allocator_type, typename balancing_policy>
   friend class bst;
 };
 
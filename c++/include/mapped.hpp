@@ -0,0 +1,297 @@
+#ifndef mapped_hpp
+#define mapped_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "frozen.hpp"
+
+
+// ============================= MAPPED BST ==============================
+//
+// Read-only tree answering queries straight from a file mapped in memory
+// (with the POSIX mmap). The file, written by write() out of a
+// frozen_bst, holds no pointer: after a header the keys are stored in
+// Eytzinger order, as in the frozen_bst, in an array aligned to a cache
+// line, followed by the values in a parallel array, so that positions
+// are the same in every process mapping it. Opening the tree only maps
+// the file, in O(1) whatever its size: nothing is read or copied on the
+// heap, the pages are loaded by the operating system when a query first
+// touches them and stay in the page cache, shared by all the processes
+// mapping the same file. Keys and values must be trivially copyable, and
+// are stored in the byte order of the machine.
+
+template<typename key_type, typename value_type, typename comparison_type = std::less<key_type> >
+class mapped_bst{
+
+  static_assert(std::is_trivially_copyable<key_type>::value && std::is_trivially_copyable<value_type>::value,
+                "mapped_bst: keys and values must be trivially copyable");
+
+  // header at the beginning of the file, the arrays follow at the given
+  // offsets, which are multiples of the size of a cache line
+  struct _header{
+
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t key_size;
+    std::uint32_t value_size;
+    std::uint32_t reserved;
+    std::uint64_t count;
+    std::uint64_t keys_offset;
+    std::uint64_t values_offset;
+  };
+
+  static constexpr std::size_t line{64};
+
+  static constexpr char magic[8]{'b', 's', 't', 'm', 'a', 'p', '\0', '\0'};
+
+  comparison_type op;		// comparison operator
+
+  void* data;			// the mapped file, nullptr if nothing is mapped
+
+  std::size_t length;		// length of the mapping
+
+  const key_type* keys;		// keys in Eytzinger order, position 0 unused
+
+  const value_type* values;	// values, parallel to keys
+
+  std::size_t n;		// number of pairs
+
+  static std::uint64_t _align(std::uint64_t x) noexcept{ return (x + line - 1) / line * line; }
+
+  // positions of the first key not less than x and of the key x, or 0
+  template<typename K>
+  std::size_t _lower_bound(const K& x) const noexcept{
+
+    return _eytzinger_search(keys, n, [this, &x](const key_type& key){ return op(key, x); });
+  }
+
+  template<typename K>
+  std::size_t _find(const K& x) const noexcept{
+
+    std::size_t k{_lower_bound(x)};
+
+    return (k && !op(x, keys[k])) ? k : 0;
+  }
+
+  // position of the first key greater than x, or 0
+  template<typename K>
+  std::size_t _upper_bound(const K& x) const noexcept{
+
+    return _eytzinger_search(keys, n, [this, &x](const key_type& key){ return !op(x, key); });
+  }
+
+  static std::size_t _up(std::size_t k) noexcept{ return _eytzinger_up(k); }
+
+  std::size_t _first(std::size_t k) const noexcept{ return _eytzinger_first(k, n); }
+
+  void _unmap() noexcept{
+
+    if(data){ munmap(data, length); }
+
+    data = nullptr;
+  }
+
+  template<typename F>
+  friend class _frozen_iterator;
+
+  public:
+  using pair_type = typename std::pair<const key_type&, const value_type&>;
+
+  using const_iterator = _frozen_iterator<mapped_bst>;
+  using iterator = const_iterator;
+
+  // ============================== WRITE ===============================
+  //
+  // Writes the arrays of a snapshot to a file in the layout described
+  // above, for instance write(path, tree.freeze()). Throws
+  // std::runtime_error if the file cannot be written.
+
+  static void write(const std::string& path, const frozen_bst<key_type, value_type, comparison_type>& snapshot){
+
+    _header h{};
+
+    std::memcpy(h.magic, magic, sizeof(magic));
+    h.version = 1;
+    h.key_size = sizeof(key_type);
+    h.value_size = sizeof(value_type);
+    h.count = snapshot.n;
+    h.keys_offset = _align(sizeof(_header));
+    h.values_offset = _align(h.keys_offset + (snapshot.n + 1) * sizeof(key_type));
+
+    std::ofstream os{path, std::ios::binary};
+
+    if(!os){ throw std::runtime_error{"mapped_bst: cannot open " + path}; }
+
+    const std::vector<char> padding(line, '\0');
+
+    os.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    os.write(padding.data(), h.keys_offset - sizeof(h));
+    os.write(reinterpret_cast<const char*>(snapshot.keys.data()), (snapshot.n + 1) * sizeof(key_type));
+    os.write(padding.data(), h.values_offset - h.keys_offset - (snapshot.n + 1) * sizeof(key_type));
+    os.write(reinterpret_cast<const char*>(snapshot.values.data()), (snapshot.n + 1) * sizeof(value_type));
+
+    if(!os){ throw std::runtime_error{"mapped_bst: cannot write " + path}; }
+  }
+
+
+  // ctor for an empty tree, with nothing mapped
+
+  mapped_bst() noexcept: op{}, data{nullptr}, length{0}, keys{nullptr}, values{nullptr}, n{0} {}
+
+  // ctor mapping a file written by write(): std::runtime_error is thrown
+  // if it cannot be mapped or does not hold a tree of these types
+
+  explicit mapped_bst(const std::string& path, comparison_type comp = comparison_type{}):
+    op{comp}, data{nullptr}, length{0}, keys{nullptr}, values{nullptr}, n{0} {
+
+    int fd{open(path.c_str(), O_RDONLY)};
+
+    if(fd < 0){ throw std::runtime_error{"mapped_bst: cannot open " + path}; }
+
+    struct stat st;
+
+    if(fstat(fd, &st) != 0 || std::size_t(st.st_size) < sizeof(_header)){
+
+      close(fd);
+      throw std::runtime_error{"mapped_bst: " + path + " is not a mapped tree"};
+    }
+
+    length = st.st_size;
+    data = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);				// the mapping stays valid
+
+    if(data == MAP_FAILED){
+
+      data = nullptr;
+      throw std::runtime_error{"mapped_bst: cannot map " + path};
+    }
+
+    _header h;
+    std::memcpy(&h, data, sizeof(h));
+
+    // the fields come from the file: the bounds are checked by
+    // subtraction, so that nothing can overflow
+    if(std::memcmp(h.magic, magic, sizeof(magic)) != 0 || h.version != 1 || h.key_size != sizeof(key_type)
+       || h.value_size != sizeof(value_type) || h.keys_offset % line != 0 || h.values_offset % line != 0
+       || h.keys_offset < sizeof(_header) || h.keys_offset > h.values_offset || h.values_offset > length
+       || h.count >= (h.values_offset - h.keys_offset) / sizeof(key_type)
+       || h.count >= (length - h.values_offset) / sizeof(value_type)){
+
+      _unmap();
+      throw std::runtime_error{"mapped_bst: " + path + " is not a mapped tree of this type"};
+    }
+
+    keys = reinterpret_cast<const key_type*>(static_cast<const char*>(data) + h.keys_offset);
+    values = reinterpret_cast<const value_type*>(static_cast<const char*>(data) + h.values_offset);
+    n = h.count;
+  }
+
+  // the mapping has a single owner, so the tree can be moved but not copied
+
+  mapped_bst(mapped_bst&& x) noexcept:
+    op{std::move(x.op)}, data{x.data}, length{x.length}, keys{x.keys}, values{x.values}, n{x.n} {
+
+    x.data = nullptr;
+    x.n = 0;
+  }
+
+  mapped_bst& operator=(mapped_bst&& x) noexcept{
+
+    if(this != &x){
+
+      _unmap();
+      op = std::move(x.op);
+      data = x.data;
+      length = x.length;
+      keys = x.keys;
+      values = x.values;
+      n = x.n;
+      x.data = nullptr;
+      x.n = 0;
+    }
+
+    return *this;
+  }
+
+  mapped_bst(const mapped_bst&) = delete;
+  mapped_bst& operator=(const mapped_bst&) = delete;
+
+  // dtor, the file is unmapped
+  ~mapped_bst() noexcept{ _unmap(); }
+
+
+  // ============================== FIND ==============================
+  //
+  // Finds the pair with the given key, returning end() if it is not
+  // present. With a transparent comparison operator any type comparable
+  // with the keys can be looked for.
+
+  const_iterator find(const key_type& x) const noexcept{ return const_iterator{this, _find(x)}; }
+
+  template<typename K, typename C = comparison_type, typename = typename C::is_transparent>
+  const_iterator find(const K& x) const noexcept{ return const_iterator{this, _find(x)}; }
+
+  std::size_t count(const key_type& x) const noexcept{ return _find(x) ? 1 : 0; }
+
+  // ===================== LOWER BOUND and UPPER BOUND ==================
+  //
+  // Iterators to the first pair whose key is not less than x and to the
+  // first one whose key is greater than x, or end(): the pairs with keys
+  // in [lo, hi) go from lower_bound(lo) to lower_bound(hi).
+
+  const_iterator lower_bound(const key_type& x) const noexcept{ return const_iterator{this, _lower_bound(x)}; }
+
+  const_iterator upper_bound(const key_type& x) const noexcept{ return const_iterator{this, _upper_bound(x)}; }
+
+  template<typename K, typename C = comparison_type, typename = typename C::is_transparent>
+  const_iterator lower_bound(const K& x) const noexcept{ return const_iterator{this, _lower_bound(x)}; }
+
+  template<typename K, typename C = comparison_type, typename = typename C::is_transparent>
+  const_iterator upper_bound(const K& x) const noexcept{ return const_iterator{this, _upper_bound(x)}; }
+
+  // ========================== BEGIN and END ==========================
+
+  const_iterator begin() const noexcept{ return const_iterator{this, _first(1)}; }
+  const_iterator cbegin() const noexcept{ return begin(); }
+
+  const_iterator end() const noexcept{ return const_iterator{this, 0}; }
+  const_iterator cend() const noexcept{ return end(); }
+
+  // ============================== SIZE ===============================
+
+  std::size_t size() const noexcept{ return n; }
+
+  bool empty() const noexcept{ return n == 0; }
+
+  // ========================= PUT TO OPERATOR =========================
+  //
+  // Prints keys and values from the smallest to the largest key.
+
+  friend
+  std::ostream& operator<<(std::ostream& os, const mapped_bst& x){
+
+    os << "Key:\t" << "Value:\n";
+
+    for(const auto& i : x){
+
+      os << i.first  << "   \t" << i.second << "\n";
+    }
+
+    return os;
+  }
+};
+
+#endif
@@ -1,16 +1,24 @@
 #ifndef node_hpp
 #define node_hpp
 
+#include <cstdint>
+#include <utility>
+
 template<typename N, typename TT>          // class iterator (see iterator.hpp)
 class _iterator;
 
-template<typename key_type, typename value_type, typename comparison_type>
+template<typename T, typename A>           // class node handle (see node_handle.hpp)
+class _node_handle;
+
+template<typename key_type, typename value_type, typename comparison_type, typename allocator_type, typename balancing_policy>
 class bst;
 
 
 // ============================== NODE ===============================
 //
 // Structure encoding the concept of a node in a binary search tree.
+// Nodes are allocated and destroyed by the tree they belong to, through
+// its allocator, so the links to the children are plain raw pointers.
 
 template<typename T>
 class node{
@@ -19,29 +27,51 @@ class node{
   node* parent;
   
   // pointer to the right child
-  std::unique_ptr<node<T>> right;
+  node* right;
 
   // pointer to the left child
-  std::unique_ptr<node<T>> left;
+  node* left;
+
+  // number of nodes in the subtree rooted in this node, itself included;
+  // 32 bits fit in the padding before the colour on 64 bit machines
+  std::uint32_t size;
+
+  // colour of the node, only used by self-balancing trees
+  bool red;
 
   // each node stores a key-value pair
   T pair;
 
+  // the ctors are public since nodes are constructed in place through the
+  // allocator of the tree
+  public:
+
   // ctor
-  node() noexcept: parent{nullptr}, left{nullptr}, right{nullptr}, pair{} {} //create an empty node, all pointers are set to nullptr
+  node() noexcept: parent{nullptr}, right{nullptr}, left{nullptr}, size{1}, red{false}, pair{} {} //create an empty node, all pointers are set to nullptr
 
   // copy ctor with parent and pair
   node(node<T>* p, const T& data):
-    parent{p}, right{nullptr}, left{nullptr}, pair{data}{}
+    parent{p}, right{nullptr}, left{nullptr}, size{1}, red{false}, pair{data}{}
   
   // move ctor with parent and pair
   node(node<T>* p, T&& data):
-    parent{p}, right{nullptr}, left{nullptr}, pair{std::move(data)}{}
+    parent{p}, right{nullptr}, left{nullptr}, size{1}, red{false}, pair{std::move(data)}{}
+
+  // ctor with parent and the pieces of the pair, i.e. two tuples with
+  // the arguments of the key and value ctors
+  template<typename K, typename V>
+  node(node<T>* p, std::piecewise_construct_t pc, K&& k, V&& v):
+    parent{p}, right{nullptr}, left{nullptr}, size{1}, red{false}, pair{pc, std::forward<K>(k), std::forward<V>(v)}{}
+
+  private:
 
   template<typename N, typename TT>
   friend class _iterator;
 
-  template<typename key_type, typename value_type, typename comparison_type>
+  template<typename TT, typename A>
+  friend class _node_handle;
+
+  template<typename key_type, typename value_type, typename comparison_type, typename allocator_type, typename balancing_policy>
   friend class bst;
 };
 
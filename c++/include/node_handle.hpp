@@ -0,0 +1,101 @@
+#ifndef node_handle_hpp
+#define node_handle_hpp
+
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include "node.hpp"
+
+template<typename key_type, typename value_type, typename comparison_type, typename allocator_type, typename balancing_policy>
+class bst;
+
+
+// ============================ NODE HANDLE ==============================
+//
+// Owner of a node extracted from a tree through bst::extract(), which
+// can be given back to a tree (the same one or another one with an equal
+// allocator) through bst::insert(). While it is in the handle the node
+// is not linked to any tree, and it keeps its key-value pair: moving it
+// between trees neither allocates nor copies the pair. A handle still
+// holding its node when destroyed gives it back to the allocator it was
+// taken from, a copy of which is kept by the handle.
+
+template<typename T, typename A>
+class _node_handle{
+
+  using node_traits = std::allocator_traits<A>;
+
+  node<T>* ptr;			// owned node, nullptr for an empty handle
+
+  std::optional<A> alloc;	// allocator of the node, only for a non-empty handle
+
+  // ctor used by bst, taking ownership of an unlinked node
+  _node_handle(node<T>* n, const A& a): ptr{n}, alloc{a} {}
+
+  // gives the node up, leaving the handle empty
+  node<T>* _release() noexcept{
+
+    node<T>* n{ptr};
+    ptr = nullptr;
+    alloc.reset();
+    return n;
+  }
+
+  // destroys the owned node, if any
+  void _destroy() noexcept{
+
+    if(ptr){
+
+      node_traits::destroy(*alloc, ptr);
+      node_traits::deallocate(*alloc, ptr, 1);
+      _release();
+    }
+  }
+
+  public:
+  using key_type = typename std::remove_const<typename T::first_type>::type;
+  using mapped_type = typename T::second_type;
+  using allocator_type = A;
+
+  // an empty handle
+  _node_handle() noexcept: ptr{nullptr}, alloc{} {}
+
+  // handles can only be moved, the node has a single owner
+  _node_handle(_node_handle&& x) noexcept: ptr{x.ptr}, alloc{std::move(x.alloc)} { x._release(); }
+
+  _node_handle& operator=(_node_handle&& x) noexcept{
+
+    if(this != &x){
+
+      _destroy();
+      ptr = x.ptr;
+      alloc = std::move(x.alloc);
+      x._release();
+    }
+
+    return *this;
+  }
+
+  _node_handle(const _node_handle&) = delete;
+  _node_handle& operator=(const _node_handle&) = delete;
+
+  ~_node_handle(){ _destroy(); }
+
+  bool empty() const noexcept{ return !ptr; }
+
+  explicit operator bool() const noexcept{ return ptr != nullptr; }
+
+  // key and value of the owned node, the handle must not be empty
+  const key_type& key() const noexcept{ return ptr->pair.first; }
+
+  mapped_type& mapped() const noexcept{ return ptr->pair.second; }
+
+  allocator_type get_allocator() const{ return *alloc; }
+
+  // bst takes the nodes out of the handles and puts them in
+  template<typename key_type, typename value_type, typename comparison_type, typename allocator_type, typename balancing_policy>
+  friend class bst;
+};
+
+#endif
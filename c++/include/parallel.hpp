@@ -0,0 +1,334 @@
+#ifndef parallel_hpp
+#define parallel_hpp
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+// ============================== THREADS ================================
+//
+// Below _parallel_grain elements per thread the work is left to a single
+// thread, since starting the others would cost more than it saves.
+// _thread_count turns a requested number of threads into an actual one:
+// 0 stands for one thread per hardware thread.
+
+constexpr std::size_t _parallel_grain{4096};
+
+inline std::size_t _thread_count(std::size_t threads) noexcept{
+
+  if(threads == 0){ threads = std::thread::hardware_concurrency(); }
+
+  return threads ? threads : 1;
+}
+
+
+// ============================= THREAD POOL =============================
+//
+// Workers shared by all the parallel functions, so that a call does not
+// pay for starting and joining its threads: on trees of a few hundred
+// thousand nodes that costs as much as the work itself. The pool is
+// created on first use and grows up to the largest number of helpers
+// asked for so far; its workers wait on a queue of jobs and are joined
+// when the program ends. If a worker cannot be started the pool keeps
+// the ones it has.
+
+class _thread_pool{
+
+  std::mutex m;				// guards jobs, stopping and workers
+  std::condition_variable ready;	// signalled when a job is queued
+  std::deque<std::function<void()>> jobs;	// jobs waiting for a worker
+  std::vector<std::thread> workers;
+  bool stopping;			// raised by the dtor
+
+  void _work(){
+
+    std::unique_lock<std::mutex> lock{m};
+
+    for(;;){
+
+      ready.wait(lock, [this](){ return stopping || !jobs.empty(); });
+
+      if(jobs.empty()){ return; }	// stopping, and nothing left to run
+
+      auto job = std::move(jobs.front());
+      jobs.pop_front();
+
+      lock.unlock();
+      job();				// jobs do not throw
+      lock.lock();
+    }
+  }
+
+  _thread_pool(): stopping{false} {}
+
+  public:
+  _thread_pool(const _thread_pool&) = delete;
+  _thread_pool& operator=(const _thread_pool&) = delete;
+
+  ~_thread_pool(){
+
+    {
+      std::lock_guard<std::mutex> lock{m};
+      stopping = true;
+    }
+
+    ready.notify_all();
+
+    for(auto& t : workers){ t.join(); }
+  }
+
+  static _thread_pool& instance(){
+
+    static _thread_pool pool;
+    return pool;
+  }
+
+  // queues up to n copies of job, starting workers until there are at
+  // least n of them, and returns how many copies have been queued
+  std::size_t run(std::size_t n, const std::function<void()>& job) noexcept{
+
+    std::size_t queued{0};
+
+    {
+      std::lock_guard<std::mutex> lock{m};
+
+      try{
+        while(workers.size() < n){ workers.emplace_back(&_thread_pool::_work, this); }
+      }catch(...){}
+
+      try{
+        for(; queued < n && queued < workers.size(); ++queued){ jobs.push_back(job); }
+      }catch(...){}
+    }
+
+    ready.notify_all();
+
+    return queued;
+  }
+};
+
+
+// ============================ PARALLEL RUN =============================
+//
+// Runs f(0), ..., f(tasks-1) on up to `threads` threads, the calling one
+// included, the others taken from the thread pool. Each thread takes the
+// next task still to be run until none is left, so that tasks of uneven
+// length are spread over the threads. If a task throws no further task
+// is started and, once every thread has stopped, the first exception is
+// rethrown.
+// The helpers queued in the pool may start late, even after all the
+// tasks are done: once the calling thread runs out of tasks the run is
+// closed, it waits only for the helpers already working, and the others
+// find it closed and return without touching f. So a task may call
+// _parallel_run in turn without waiting for busy workers.
+
+template<typename F>
+void _parallel_run(std::size_t threads, std::size_t tasks, F&& f){
+
+  threads = std::max<std::size_t>(1, std::min(threads, tasks));
+
+  struct run_state{
+
+    std::atomic<std::size_t> next{0};		// next task to be run
+    std::mutex m;				// guards the fields below
+    std::condition_variable idle;		// signalled when a helper stops
+    std::size_t active{0};			// helpers working
+    std::size_t helpers{1};			// helper indices handed out, 0 is the caller
+    bool closed{false};				// no more helpers may start
+    std::vector<std::exception_ptr> errors;	// exception thrown in each thread
+  };
+
+  auto state = std::make_shared<run_state>();
+  state->errors.resize(threads);
+
+  auto work = [&f, tasks](run_state& st, std::size_t w){
+
+    try{
+      for(std::size_t t; (t = st.next++) < tasks; ){ f(t); }
+
+    }catch(...){
+
+      st.errors[w] = std::current_exception();
+      st.next = tasks;				// stop the other threads
+    }
+  };
+
+  if(threads > 1){
+
+    try{
+
+      std::function<void()> helper{[state, &work](){
+
+        std::size_t w;
+
+        {
+          std::lock_guard<std::mutex> lock{state->m};
+          if(state->closed){ return; }
+          w = state->helpers++;
+          ++state->active;
+        }
+
+        work(*state, w);				// work and f outlive the open run
+
+        std::lock_guard<std::mutex> lock{state->m};
+        --state->active;
+        state->idle.notify_one();
+      }};
+
+      _thread_pool::instance().run(threads - 1, helper);
+
+    }catch(...){}				// without helpers the caller runs every task
+  }
+
+  work(*state, 0);
+
+  {
+    std::unique_lock<std::mutex> lock{state->m};
+    state->closed = true;
+    state->idle.wait(lock, [&state](){ return state->active == 0; });
+  }
+
+  for(auto& e : state->errors){ if(e){ std::rethrow_exception(e); } }
+}
+
+
+// ======================== PARALLEL SORT UNIQUE =========================
+//
+// Returns pointers to the pairs of v sorted by key according to comp,
+// keeping only the first pair of v with each key, as a sequence of
+// insertions would. Only the pointers are sorted, with a sample sort: a
+// sorted sample of the keys gives the bounds of some buckets of keys,
+// each thread finds the bucket of the pairs of its slice of v and then
+// copies their pointers in place. Every bucket is sorted on its own,
+// ties broken by the position in v, and only the first pointer of each
+// key is kept. Equal keys always end up in the same bucket, so putting
+// the buckets one after the other gives the result, which does not
+// depend on the number of threads. The comparison operator is called
+// concurrently by the threads.
+
+template<typename P, typename C>
+std::vector<P*> _parallel_sort_unique(std::vector<P>& v, C& comp, std::size_t threads){
+
+  const std::size_t n{v.size()};
+  const std::size_t slices{std::max<std::size_t>(1, std::min(threads, n / _parallel_grain))};
+  const std::size_t buckets{slices == 1 ? 1 : 4 * slices};	// more buckets than threads to even out the load
+  const std::size_t oversampling{16};
+
+  auto key_less = [&comp](const P* a, const P* b){ return comp(a->first, b->first); };
+  auto less = [&comp](const P* a, const P* b){
+
+    return comp(a->first, b->first) || (!comp(b->first, a->first) && a < b);
+  };
+
+  // bounds of the buckets, out of an evenly spaced sample of v
+
+  std::vector<const P*> bounds;
+
+  if(buckets > 1){
+
+    std::vector<const P*> sample(buckets * oversampling);
+
+    for(std::size_t i{0}; i < sample.size(); ++i){ sample[i] = &v[i * n / sample.size()]; }
+
+    std::sort(sample.begin(), sample.end(), less);
+
+    for(std::size_t b{1}; b < buckets; ++b){ bounds.push_back(sample[b * oversampling]); }
+  }
+
+  // bucket of each pair, and how many pairs of each slice go in each bucket
+
+  std::vector<unsigned> ids(n);
+  std::vector<std::size_t> counts(slices * buckets, 0);
+
+  _parallel_run(threads, slices, [&](std::size_t s){
+
+    auto c = &counts[s * buckets];
+
+    for(std::size_t i{s * n / slices}; i < (s+1) * n / slices; ++i){
+
+      ids[i] = std::upper_bound(bounds.begin(), bounds.end(), &v[i], key_less) - bounds.begin();
+      ++c[ids[i]];
+    }
+  });
+
+  // where the pointers of each slice go in each bucket
+
+  std::vector<std::size_t> starts(buckets + 1);
+  std::size_t total{0};
+
+  for(std::size_t b{0}; b < buckets; ++b){
+
+    starts[b] = total;
+
+    for(std::size_t s{0}; s < slices; ++s){
+
+      auto count = counts[s * buckets + b];
+      counts[s * buckets + b] = total;
+      total += count;
+    }
+  }
+
+  starts[buckets] = total;
+
+  std::vector<P*> scattered(n);
+
+  _parallel_run(threads, slices, [&](std::size_t s){
+
+    auto c = &counts[s * buckets];
+
+    for(std::size_t i{s * n / slices}; i < (s+1) * n / slices; ++i){ scattered[c[ids[i]]++] = &v[i]; }
+  });
+
+  // every bucket is sorted and deduplicated on its own
+
+  std::vector<std::size_t> kept(buckets + 1, 0);
+
+  _parallel_run(threads, buckets, [&](std::size_t b){
+
+    auto first = scattered.begin() + starts[b];
+    auto last = scattered.begin() + starts[b+1];
+
+    std::sort(first, last, less);
+
+    kept[b+1] = std::unique(first, last, [&comp](const P* x, const P* y){ return !comp(x->first, y->first); }) - first;
+  });
+
+  for(std::size_t b{0}; b < buckets; ++b){ kept[b+1] += kept[b]; }
+
+  std::vector<P*> result(kept[buckets]);
+
+  _parallel_run(threads, buckets, [&](std::size_t b){
+
+    std::copy(scattered.begin() + starts[b], scattered.begin() + starts[b] + (kept[b+1] - kept[b]), result.begin() + kept[b]);
+  });
+
+  return result;
+}
+
+
+// ============================ MOVING DEREF =============================
+//
+// Iterator over a sequence of pointers giving the objects they point to
+// as rvalues, so that they are moved wherever they are read into.
+
+template<typename P>
+struct _moving_deref{
+
+  P* const* ptr;
+
+  P&& operator*() const noexcept{ return std::move(**ptr); }
+
+  _moving_deref& operator++() noexcept{ ++ptr; return *this; }
+};
+
+#endif
@@ -0,0 +1,659 @@
+#ifndef persistent_hpp
+#define persistent_hpp
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <utility>
+
+
+// ========================== PERSISTENT NODE ============================
+//
+// Node of a persistent tree. Once built it is never modified, so it can
+// be shared by any number of versions of the tree, which is why it has
+// no link to its parent, of which there may be several. It is owned by
+// its parents and by the versions whose root it is, counted in refs,
+// and is destroyed when the last of them lets it go. The count is
+// atomic, so that versions sharing nodes can be used and dropped by
+// different threads.
+
+template<typename T>
+struct _persistent_node{
+
+  mutable std::atomic<std::size_t> refs;	// number of owners
+
+  const _persistent_node* left;			// left child
+
+  const _persistent_node* right;		// right child
+
+  unsigned char height;				// height of the subtree, 1 for a leaf
+
+  T pair;					// key-value pair
+
+  // ctor taking over a reference to each child
+  template<typename... Types>
+  _persistent_node(const _persistent_node* l, const _persistent_node* r, Types&&... args):
+    refs{1}, left{l}, right{r}, height(1 + std::max(l ? l->height : 0, r ? r->height : 0)),
+    pair(std::forward<Types>(args)...) {}
+};
+
+
+// ======================== PERSISTENT ITERATOR ==========================
+//
+// Forward iterator over a version of a persistent tree. Without parent
+// links the way back up is kept in the iterator itself: a stack of the
+// nodes whose left subtree is being visited, the current one on top.
+// The height of an AVL tree of n nodes is less than 1.44 log2(n+2), so
+// the stack has room enough for any number of nodes that fits in memory.
+
+template<typename N, typename T>
+class _persistent_iterator{
+
+  static constexpr std::size_t max_height{96};
+
+  std::array<const N*, max_height> stack;	// pending ancestors, current node on top
+
+  std::size_t depth;				// number of nodes in the stack, 0 for end()
+
+  // pushes n and the nodes down its left spine
+  void _descend(const N* n) noexcept{
+
+    for(; n; n = n->left){ stack[depth++] = n; }
+  }
+
+  template<typename key_type, typename value_type, typename comparison_type, typename allocator_type>
+  friend class persistent_bst;
+
+  public:
+  using value_type = T;
+  using reference = const T&;
+  using pointer = const T*;
+  using difference_type = std::ptrdiff_t;
+  using iterator_category = std::forward_iterator_tag;
+
+  _persistent_iterator() noexcept: depth{0} {}
+
+  reference operator*() const noexcept{ return stack[depth-1]->pair; }
+
+  pointer operator->() const noexcept{ return &**this; }
+
+  _persistent_iterator& operator++() noexcept{
+
+    const N* n{stack[--depth]};
+    _descend(n->right);
+
+    return *this;
+  }
+
+  _persistent_iterator operator++(int) noexcept{
+
+    auto tmp{*this};
+    ++(*this);
+    return tmp;
+  }
+
+  friend bool operator==(const _persistent_iterator& a, const _persistent_iterator& b) noexcept{
+
+    return a.depth == b.depth && (a.depth == 0 || a.stack[a.depth-1] == b.stack[b.depth-1]);
+  }
+
+  friend bool operator!=(const _persistent_iterator& a, const _persistent_iterator& b) noexcept{ return !(a == b); }
+};
+
+
+// =========================== PERSISTENT BST ============================
+//
+// Binary search tree whose versions are immutable: insert and erase
+// build a new version copying only the nodes on the path from the root
+// to the key (and the few more moved by the rebalancing), while all the
+// other nodes are shared with the previous version. A copy of the tree,
+// also given by snapshot(), shares the root and costs O(1); it is not
+// affected by the later changes of the original, and the nodes of a
+// version are given back to the allocator once no copy holds them any
+// more. Different copies can be read and modified by different threads
+// without locks, since the shared nodes are never written; a single copy
+// can be modified by one thread at a time, while other threads take
+// snapshots of it (or copy it): a new version is published by swapping
+// the root under a spin lock, held only to swap or to retain the root,
+// so a snapshot always holds a whole version. The other threads must
+// read the snapshots, not the tree being modified. The tree is kept balanced
+// with the AVL rules, which only need the height of the subtrees, so
+// that every operation is O(log n). Keys and values must be copyable,
+// since the pairs on the copied paths are copied, and the allocator must
+// be safe to use from the threads dropping the last copy of a node.
+
+template<typename key_type, typename value_type, typename comparison_type = std::less<key_type>,
+         typename allocator_type = std::allocator<std::pair<const key_type, value_type>> >
+class persistent_bst{
+
+  public:
+  using pair_type = std::pair<const key_type, value_type>;
+
+  private:
+  using node_type = _persistent_node<pair_type>;
+  using node_ptr = const node_type*;
+  using node_allocator = typename std::allocator_traits<allocator_type>::template rebind_alloc<node_type>;
+  using node_traits = std::allocator_traits<node_allocator>;
+
+  public:
+  using const_iterator = _persistent_iterator<node_type, pair_type>;
+  using iterator = const_iterator;
+
+  private:
+  comparison_type op;		// comparison operator
+
+  node_allocator alloc;		// allocator of the nodes
+
+  node_ptr root;		// root of this version, of which the tree holds a reference
+
+  std::size_t node_count;	// number of pairs in this version
+
+  mutable std::atomic<bool> publishing;	// spin lock over root and node_count
+
+
+  //============================= _PUBLISH ==============================
+  //
+  // Private auxiliary functions guarding root and node_count, which the
+  // writer replaces while other threads may be copying them. The lock is
+  // held only to read and retain the root, or to swap it: otherwise a
+  // reader could retain a root the writer has just released, or pair a
+  // root with the size of another version. The old root is released
+  // after the lock is given back.
+
+  void _lock() const noexcept{
+
+    while(publishing.exchange(true, std::memory_order_acquire)){
+
+      while(publishing.load(std::memory_order_relaxed)){ std::this_thread::yield(); }
+    }
+  }
+
+  void _unlock() const noexcept{ publishing.store(false, std::memory_order_release); }
+
+  // the root, retained, and the size of the current version
+  std::pair<node_ptr, std::size_t> _share() const noexcept{
+
+    _lock();
+    std::pair<node_ptr, std::size_t> v{root, node_count};
+    _retain(root);
+    _unlock();
+
+    return v;
+  }
+
+  // publishes a new version, of whose root the tree takes ownership
+  void _replace_root(node_ptr n, std::size_t count) noexcept{
+
+    _lock();
+    node_ptr old{root};
+    root = n;
+    node_count = count;
+    _unlock();
+
+    _release(old);
+  }
+
+  //======================= _RETAIN and _RELEASE ========================
+  //
+  // Private auxiliary functions adding and removing an owner of a node.
+  // When the last owner goes the node is destroyed and its children lose
+  // an owner in turn: the left ones are released recursively, which goes
+  // as deep as the height of the tree, the right ones in a loop.
+
+  static void _retain(node_ptr n) noexcept{ if(n){ n->refs.fetch_add(1, std::memory_order_relaxed); } }
+
+  void _release(node_ptr n) noexcept{
+
+    while(n && n->refs.fetch_sub(1, std::memory_order_acq_rel) == 1){
+
+      node_ptr l{n->left}, r{n->right};
+      auto p = const_cast<node_type*>(n);
+
+      node_traits::destroy(alloc, p);
+      node_traits::deallocate(alloc, p, 1);
+
+      _release(l);
+      n = r;
+    }
+  }
+
+  //============================== _MAKE ================================
+  //
+  // A private auxiliary function that builds a node out of args with
+  // children l and r, taking over a reference to each of them: if the
+  // node cannot be built they are released.
+
+  template<typename... Types>
+  node_ptr _make(node_ptr l, node_ptr r, Types&&... args){
+
+    node_type* n{nullptr};
+
+    try{
+      n = node_traits::allocate(alloc, 1);
+      node_traits::construct(alloc, n, l, r, std::forward<Types>(args)...);
+
+    }catch(...){
+
+      if(n){ node_traits::deallocate(alloc, n, 1); }
+      _release(l);
+      _release(r);
+      throw;
+    }
+
+    return n;
+  }
+
+  static unsigned char _height(node_ptr n) noexcept{ return n ? n->height : 0; }
+
+  //============================= _BALANCE ==============================
+  //
+  // A private auxiliary function that builds a node out of args with
+  // children l and r, as _make, when their heights may differ by two.
+  // The higher one is then rotated up, twice if its inner subtree is the
+  // higher one: since l and r may be shared the rotations build new
+  // nodes out of the pairs of the rotated ones, at most two.
+
+  template<typename... Types>
+  node_ptr _balance(node_ptr l, node_ptr r, Types&&... args){
+
+    if(_height(l) > _height(r) + 1){
+
+      try{
+
+	if(_height(l->left) >= _height(l->right)){	// single rotation
+
+	  _retain(l->left);
+	  _retain(l->right);
+
+	  node_ptr new_right;
+
+	  try{
+	    new_right = _make(l->right, r, std::forward<Types>(args)...);
+
+	  }catch(...){ _release(l->left); throw; }
+
+	  node_ptr n{_make(l->left, new_right, l->pair)};
+	  _release(l);
+	  return n;
+	}
+
+	node_ptr lr{l->right};				// double rotation
+
+	_retain(l->left);
+	_retain(lr->left);
+	_retain(lr->right);
+
+	node_ptr new_left, new_right;
+
+	try{
+	  new_left = _make(l->left, lr->left, l->pair);
+
+	}catch(...){ _release(lr->right); _release(r); throw; }
+
+	try{
+	  new_right = _make(lr->right, r, std::forward<Types>(args)...);
+
+	}catch(...){ _release(new_left); throw; }
+
+	node_ptr n{_make(new_left, new_right, lr->pair)};
+	_release(l);
+	return n;
+
+      }catch(...){ _release(l); throw; }
+    }
+
+    if(_height(r) > _height(l) + 1){
+
+      try{
+
+	if(_height(r->right) >= _height(r->left)){	// single rotation
+
+	  _retain(r->right);
+	  _retain(r->left);
+
+	  node_ptr new_left;
+
+	  try{
+	    new_left = _make(l, r->left, std::forward<Types>(args)...);
+
+	  }catch(...){ _release(r->right); throw; }
+
+	  node_ptr n{_make(new_left, r->right, r->pair)};
+	  _release(r);
+	  return n;
+	}
+
+	node_ptr rl{r->left};				// double rotation
+
+	_retain(r->right);
+	_retain(rl->right);
+	_retain(rl->left);
+
+	node_ptr new_left, new_right;
+
+	try{
+	  new_right = _make(rl->right, r->right, r->pair);
+
+	}catch(...){ _release(rl->left); _release(l); throw; }
+
+	try{
+	  new_left = _make(l, rl->left, std::forward<Types>(args)...);
+
+	}catch(...){ _release(new_right); throw; }
+
+	node_ptr n{_make(new_left, new_right, rl->pair)};
+	_release(r);
+	return n;
+
+      }catch(...){ _release(r); throw; }
+    }
+
+    return _make(l, r, std::forward<Types>(args)...);
+  }
+
+  //============================== _INSERT ==============================
+  //
+  // A private auxiliary function that returns the root of a new version
+  // of the subtree rooted in n holding a pair with key x, built out of
+  // args if it is not there. If it is there nullptr is returned and
+  // nothing is built, unless assign is true, in which case the pair is
+  // replaced by a new one built out of args.
+
+  template<bool assign, typename K, typename... Types>
+  node_ptr _insert(node_ptr n, const K& x, Types&&... args){
+
+    if(!n){ return _make(nullptr, nullptr, std::forward<Types>(args)...); }
+
+    if(op(x, n->pair.first)){
+
+      node_ptr l{_insert<assign>(n->left, x, std::forward<Types>(args)...)};
+
+      if(!l){ return nullptr; }
+
+      _retain(n->right);
+      return _balance(l, n->right, n->pair);
+    }
+
+    if(op(n->pair.first, x)){
+
+      node_ptr r{_insert<assign>(n->right, x, std::forward<Types>(args)...)};
+
+      if(!r){ return nullptr; }
+
+      _retain(n->left);
+      return _balance(n->left, r, n->pair);
+    }
+
+    if(!assign){ return nullptr; }
+
+    _retain(n->left);
+    _retain(n->right);
+    return _make(n->left, n->right, std::forward<Types>(args)...);
+  }
+
+  //============================== _ERASE ===============================
+  //
+  // Private auxiliary functions that return the root of a new version of
+  // the subtree rooted in n without the key x, or nullptr with erased
+  // set to false if x is not there. A node with two children is replaced
+  // by a copy of the pair of its successor, removed from the right
+  // subtree by _erase_min; the successor node itself stays alive as long
+  // as the old version does.
+
+  node_ptr _erase_min(node_ptr n, node_ptr& min){
+
+    if(!n->left){
+
+      min = n;
+      _retain(n->right);
+      return n->right;
+    }
+
+    node_ptr l{_erase_min(n->left, min)};
+
+    _retain(n->right);
+    return _balance(l, n->right, n->pair);
+  }
+
+  template<typename K>
+  node_ptr _erase(node_ptr n, const K& x, bool& erased){
+
+    if(!n){ erased = false; return nullptr; }
+
+    if(op(x, n->pair.first)){
+
+      node_ptr l{_erase(n->left, x, erased)};
+
+      if(!erased){ return nullptr; }
+
+      _retain(n->right);
+      return _balance(l, n->right, n->pair);
+    }
+
+    if(op(n->pair.first, x)){
+
+      node_ptr r{_erase(n->right, x, erased)};
+
+      if(!erased){ return nullptr; }
+
+      _retain(n->left);
+      return _balance(n->left, r, n->pair);
+    }
+
+    erased = true;
+
+    if(!n->left || !n->right){
+
+      node_ptr child{n->left ? n->left : n->right};
+      _retain(child);
+      return child;
+    }
+
+    node_ptr min;
+    node_ptr r{_erase_min(n->right, min)};
+
+    _retain(n->left);
+    return _balance(n->left, r, min->pair);
+  }
+
+  // inserts a new pair, if its key is not there, in a new version
+  template<typename K, typename... Types>
+  bool _insert_root(const K& x, Types&&... args){
+
+    node_ptr n{_insert<false>(root, x, std::forward<Types>(args)...)};
+
+    if(!n){ return false; }
+
+    _replace_root(n, node_count + 1);
+    return true;
+  }
+
+
+  public:
+  // ctor for an empty tree
+  persistent_bst(): op{}, alloc{}, root{nullptr}, node_count{0}, publishing{false} {}
+
+  explicit persistent_bst(comparison_type comp, const allocator_type& a = allocator_type{}):
+    op{comp}, alloc{a}, root{nullptr}, node_count{0}, publishing{false} {}
+
+  // copies share the root, in O(1); x may be modified meanwhile by another
+  // thread, so its root is retained under its lock
+  persistent_bst(const persistent_bst& x) noexcept:
+    op{x.op}, alloc{x.alloc}, root{nullptr}, node_count{0}, publishing{false} {
+
+    auto v = x._share();
+    root = v.first;
+    node_count = v.second;
+  }
+
+  persistent_bst(persistent_bst&& x) noexcept:
+    op{std::move(x.op)}, alloc{x.alloc}, root{nullptr}, node_count{0}, publishing{false} {
+
+    x._lock();
+    root = x.root;
+    node_count = x.node_count;
+    x.root = nullptr;
+    x.node_count = 0;
+    x._unlock();
+  }
+
+  persistent_bst& operator=(const persistent_bst& x) noexcept{
+
+    auto v = x._share();		// first, in case x is this tree
+    _replace_root(v.first, v.second);
+    op = x.op;
+    alloc = x.alloc;
+
+    return *this;
+  }
+
+  persistent_bst& operator=(persistent_bst&& x) noexcept{
+
+    if(this != &x){
+
+      x._lock();
+      node_ptr n{x.root};
+      std::size_t count{x.node_count};
+      x.root = nullptr;
+      x.node_count = 0;
+      x._unlock();
+
+      _replace_root(n, count);
+      op = std::move(x.op);
+      alloc = x.alloc;
+    }
+
+    return *this;
+  }
+
+  // dtor, the nodes no other version holds are given back to the allocator
+  ~persistent_bst() noexcept{ _release(root); }
+
+
+  // ============================= SNAPSHOT =============================
+  //
+  // Returns the current version of the tree, which is not affected by
+  // the later changes of this one, in O(1). It can be called by several
+  // threads while another one modifies the tree.
+
+  persistent_bst snapshot() const noexcept{ return *this; }
+
+
+  // ============================== INSERT ==============================
+  //
+  // Inserts a pair if its key is not there yet, copying the path from
+  // the root to the new node, and returns whether it has been inserted.
+  // insert_or_assign() replaces the value of a key already there.
+  // emplace() builds the pair first, since its key is needed to find
+  // the place of the node.
+
+  bool insert(const pair_type& x){ return _insert_root(x.first, x); }
+
+  bool insert(pair_type&& x){ return _insert_root(x.first, std::move(x)); }
+
+  template<typename... Types>
+  bool emplace(Types&&... args){
+
+    pair_type x(std::forward<Types>(args)...);
+    return insert(std::move(x));
+  }
+
+  template<typename M>
+  bool insert_or_assign(const key_type& k, M&& v){
+
+    bool present{contains(k)};
+
+    _replace_root(_insert<true>(root, k, k, std::forward<M>(v)), present ? node_count : node_count + 1);
+
+    return !present;
+  }
+
+
+  // ============================== ERASE ===============================
+  //
+  // Removes the pair with key x, if any, copying the path from the root
+  // to it, and returns whether it was there.
+
+  bool erase(const key_type& x){
+
+    bool erased;
+    node_ptr n{_erase(root, x, erased)};
+
+    if(!erased){ return false; }
+
+    _replace_root(n, node_count - 1);
+    return true;
+  }
+
+  void clear() noexcept{
+
+    _replace_root(nullptr, 0);
+  }
+
+
+  // ============================== LOOK-UP =============================
+  //
+  // find() returns an iterator to the pair with key x, or end();
+  // lower_bound() to the first pair whose key is not less than x. The
+  // iterator keeps the nodes it goes through in its stack.
+
+  const_iterator lower_bound(const key_type& x) const noexcept{
+
+    const_iterator it;
+
+    for(node_ptr n{root}; n; ){
+
+      if(op(n->pair.first, x)){ n = n->right; }
+      else{ it.stack[it.depth++] = n; n = n->left; }
+    }
+
+    return it;
+  }
+
+  const_iterator find(const key_type& x) const noexcept{
+
+    auto it = lower_bound(x);
+
+    return (it != end() && !op(x, it->first)) ? it : end();
+  }
+
+  bool contains(const key_type& x) const noexcept{ return find(x) != end(); }
+
+  const_iterator begin() const noexcept{ const_iterator it; it._descend(root); return it; }
+
+  const_iterator end() const noexcept{ return const_iterator{}; }
+
+  const_iterator cbegin() const noexcept{ return begin(); }
+
+  const_iterator cend() const noexcept{ return end(); }
+
+  std::size_t size() const noexcept{ return node_count; }
+
+  bool empty() const noexcept{ return node_count == 0; }
+
+  // height of the tree, 0 if empty
+  std::size_t height() const noexcept{ return _height(root); }
+
+  allocator_type get_allocator() const{ return allocator_type(alloc); }
+
+
+  // ========================= PUT TO OPERATOR ==========================
+  //
+  // Prints the key-value pairs of this version in order.
+
+  friend std::ostream& operator<<(std::ostream& os, const persistent_bst& x){
+
+    for(const auto& i : x){ os << i.first << ":" << i.second << " "; }
+
+    return os;
+  }
+
+};
+
+#endif
@@ -0,0 +1,240 @@
+#ifndef pool_hpp
+#define pool_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+// ============================== ARENA ===============================
+//
+// Untyped slab arena used by pool_allocator. Memory is obtained from the
+// system in large chunks and handed out with a bump pointer, so that
+// consecutive allocations (e.g. the nodes of a tree built by a sequence
+// of insertions) end up contiguous in memory. Single blocks given back
+// through deallocate are kept in a free list (one per block size) and
+// reused by the next allocations of the same size; the chunks themselves
+// are returned to the system only all at once by release().
+
+class node_arena{
+
+  // free list of blocks of a given size
+  struct free_list{
+    std::size_t size;
+    void* head;
+  };
+
+  std::size_t chunk_bytes;		// size of each chunk
+  std::vector<void*> chunks;		// chunks obtained from the system
+  std::vector<free_list> free_lists;	// one free list for each block size
+  char* cursor;				// first free byte of the current chunk
+  char* limit;				// one past the last byte of the current chunk
+  std::size_t used;			// number of blocks currently handed out
+
+  // returns the free list for blocks of the given size, creating it if
+  // it does not exist yet
+  void*& _head(std::size_t bytes){
+
+    for(auto& l : free_lists){
+
+      if(l.size == bytes){ return l.head; }
+    }
+
+    free_lists.push_back(free_list{bytes, nullptr});
+    return free_lists.back().head;
+  }
+
+  // obtains a new chunk from the system, able to store at least the given
+  // number of bytes
+  void _grow(std::size_t bytes){
+
+    std::size_t n{bytes > chunk_bytes ? bytes : chunk_bytes};
+
+    chunks.reserve(chunks.size()+1);	// push_back below must not throw
+    cursor = static_cast<char*>(::operator new(n));
+    limit = cursor + n;
+    chunks.push_back(cursor);
+  }
+
+  public:
+
+  explicit node_arena(std::size_t chunk = 64*1024) noexcept:
+    chunk_bytes{chunk}, chunks{}, free_lists{}, cursor{nullptr}, limit{nullptr}, used{0} {}
+
+  node_arena(const node_arena&) = delete;
+  node_arena& operator=(const node_arena&) = delete;
+
+  ~node_arena(){ release(); }
+
+  // allocates n contiguous blocks of the given size and alignment
+  void* allocate(std::size_t bytes, std::size_t align, std::size_t n){
+
+    // a single block is taken from the free list, if possible
+    if(n == 1){
+
+      void*& head = _head(bytes);
+
+      if(head){
+
+        void* p = head;
+        head = *static_cast<void**>(p);
+        ++used;
+        return p;
+      }
+    }
+
+    // otherwise bump the cursor, aligning it first
+    std::size_t total{bytes*n};
+    std::size_t pad{cursor ? (align - reinterpret_cast<std::uintptr_t>(cursor) % align) % align : 0};
+
+    if(!cursor || static_cast<std::size_t>(limit - cursor) < pad + total){
+
+      _grow(total + align);
+      pad = (align - reinterpret_cast<std::uintptr_t>(cursor) % align) % align;
+    }
+
+    void* p = cursor + pad;
+    cursor += pad + total;
+    used += n;
+    return p;
+  }
+
+  // gives back n contiguous blocks of the given size, they are pushed on
+  // the free list one by one
+  void deallocate(void* p, std::size_t bytes, std::size_t n) noexcept{
+
+    void*& head = _head(bytes);
+    char* block = static_cast<char*>(p);
+
+    for(std::size_t i{0}; i < n; ++i, block += bytes){
+
+      *reinterpret_cast<void**>(block) = head;
+      head = block;
+    }
+
+    used -= n;
+  }
+
+  // returns all the chunks to the system at once, invalidating every
+  // block handed out so far
+  void release() noexcept{
+
+    for(auto c : chunks){ ::operator delete(c); }
+
+    chunks.clear();
+    free_lists.clear();
+    cursor = nullptr;
+    limit = nullptr;
+    used = 0;
+  }
+
+  // number of blocks currently handed out
+  std::size_t in_use() const noexcept{ return used; }
+
+  // size of each chunk requested to the system
+  std::size_t chunk_size() const noexcept{ return chunk_bytes; }
+};
+
+
+// ========================== POOL ALLOCATOR ============================
+//
+// Standard-conforming allocator that takes its memory from a node_arena.
+// Copies (and rebound copies) of an allocator share the same arena, while
+// a container copied from another one gets a brand new arena.
+// Besides the usual allocate/deallocate, it offers release() and in_use(),
+// which bst uses in clear() to free all its nodes at once.
+
+template<typename T>
+class pool_allocator{
+
+  std::shared_ptr<node_arena> arena;	// arena shared by all the copies
+
+  template<typename U>
+  friend class pool_allocator;
+
+  // tells whether the two allocators share the same arena
+  template<typename U>
+  bool _same_arena(const pool_allocator<U>& x) const noexcept{ return arena == x.arena; }
+
+  // a free block stores the pointer to the next one, so blocks are at
+  // least as large and as aligned as a pointer
+  static constexpr std::size_t _align{alignof(T) > alignof(void*) ? alignof(T) : alignof(void*)};
+  static constexpr std::size_t _bytes{(sizeof(T) + _align - 1) / _align * _align};
+
+  public:
+  using value_type = T;
+  using propagate_on_container_copy_assignment = std::false_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+  using is_always_equal = std::false_type;
+
+  // ctor, the size of the chunks requested to the system can be specified
+  explicit pool_allocator(std::size_t chunk_bytes = 64*1024):
+    arena{std::make_shared<node_arena>(chunk_bytes)} {}
+
+  // copy semantics, the arena is shared; no move operations are declared,
+  // so that moving copies the pointer to the arena and a moved-from
+  // allocator still compares equal to the moved-to one, as the Allocator
+  // requirements ask
+  pool_allocator(const pool_allocator&) noexcept = default;
+  pool_allocator& operator=(const pool_allocator&) noexcept = default;
+
+  // rebinding ctor, the arena is shared
+  template<typename U>
+  pool_allocator(const pool_allocator<U>& x) noexcept: arena{x.arena} {}
+
+  T* allocate(std::size_t n){
+
+    return static_cast<T*>(arena->allocate(_bytes, _align, n));
+  }
+
+  void deallocate(T* p, std::size_t n) noexcept{
+
+    arena->deallocate(p, _bytes, n);
+  }
+
+  // a copied container does not share the memory of the original one
+  pool_allocator select_on_container_copy_construction() const{
+
+    return pool_allocator{arena->chunk_size()};
+  }
+
+  // frees all the memory handed out by this allocator and its copies
+  void release() noexcept{ arena->release(); }
+
+  // number of blocks currently handed out by this allocator and its copies
+  std::size_t in_use() const noexcept{ return arena->in_use(); }
+
+  template<typename U>
+  friend
+  bool operator==(const pool_allocator& a, const pool_allocator<U>& b) noexcept{
+
+    return a._same_arena(b);
+  }
+
+  template<typename U>
+  friend
+  bool operator!=(const pool_allocator& a, const pool_allocator<U>& b) noexcept{
+
+    return !(a==b);
+  }
+};
+
+
+// ======================== RELEASING ALLOCATOR =========================
+//
+// Trait telling whether an allocator can free all its memory at once,
+// i.e. it offers release() and in_use() as pool_allocator does.
+
+template<typename A, typename = void>
+struct is_releasing_allocator: std::false_type {};
+
+template<typename A>
+struct is_releasing_allocator<A, decltype(void(std::declval<A&>().release()),
+                                          void(std::declval<const A&>().in_use()))>: std::true_type {};
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef serializer_hpp
+#define serializer_hpp
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <type_traits>
+
+
+// ============================== SERIALIZER =============================
+//
+// Customization point telling bst::save() and bst::load() how to write
+// and read keys and values of type T in binary form. A specialization
+// provides
+//
+//   static constexpr std::uint32_t size;	// sizeof(T) if fixed, else 0
+//   static constexpr std::uint32_t tag;	// kind of T, optional
+//   static void write(std::ostream& os, const T& x);
+//   static T read(std::istream& is);
+//
+// where size and tag are written in the header of the file, so that a
+// file cannot be loaded into a tree of different types, and read()
+// leaves the stream in a failed state if the data are missing. The tag
+// tells apart types of the same size: 'u' for unsigned integers, 'i'
+// for signed ones, 'f' for floating point numbers, 'r' for any other
+// trivially copyable type and 's' for std::string; a serializer without
+// one is given 0. Trivially copyable types, which must also be default
+// constructible, are written as their raw bytes, in the byte order of
+// the machine; a `raw` member lets bst copy them in blocks instead of
+// one by one. std::string is written as its length followed by its
+// characters.
+
+template<typename T, typename = void>
+struct serializer;
+
+template<typename T>
+struct serializer<T, typename std::enable_if<std::is_trivially_copyable<T>::value>::type>{
+
+  static constexpr std::uint32_t size{sizeof(T)};
+
+  static constexpr std::uint32_t tag{std::is_floating_point<T>::value ? 'f'
+                                     : !std::is_integral<T>::value ? 'r'
+                                     : std::is_signed<T>::value ? 'i' : 'u'};
+
+  static constexpr bool raw{true};
+
+  static void write(std::ostream& os, const T& x){ os.write(reinterpret_cast<const char*>(&x), sizeof(T)); }
+
+  static T read(std::istream& is){
+
+    T x;
+    is.read(reinterpret_cast<char*>(&x), sizeof(T));
+    return x;
+  }
+};
+
+template<>
+struct serializer<std::string>{
+
+  static constexpr std::uint32_t size{0};
+
+  static constexpr std::uint32_t tag{'s'};
+
+  static void write(std::ostream& os, const std::string& x){
+
+    std::uint64_t length{x.size()};
+
+    os.write(reinterpret_cast<const char*>(&length), sizeof(length));
+    os.write(x.data(), x.size());
+  }
+
+  static std::string read(std::istream& is){
+
+    std::uint64_t length{0};
+
+    if(!is.read(reinterpret_cast<char*>(&length), sizeof(length))){ return {}; }
+
+    std::string x;
+
+    // grow with the data actually read, not with a length that may be corrupt
+    for(char buf[4096]; length > 0 && is; ){
+
+      std::size_t chunk = length < sizeof(buf) ? length : sizeof(buf);
+
+      is.read(buf, chunk);
+      x.append(buf, is.gcount());
+      length -= chunk;
+    }
+
+    return x;
+  }
+};
+
+// whether T is written as its raw bytes, so that it can be copied in blocks
+template<typename T, typename = void>
+struct _raw_serializer: std::false_type {};
+
+template<typename T>
+struct _raw_serializer<T, typename std::enable_if<serializer<T>::raw>::type>: std::true_type {};
+
+// tag of the serializer of T, 0 if it has none
+template<typename T, typename = void>
+struct _serializer_tag: std::integral_constant<std::uint32_t, 0> {};
+
+template<typename T>
+struct _serializer_tag<T, decltype(void(serializer<T>::tag))>: std::integral_constant<std::uint32_t, serializer<T>::tag> {};
+
+#endif
@@ -3,29 +3,174 @@
 #include <vector>
 #include <memory>
 #include "bst.hpp"
+#include "btree.hpp"
+#include "concurrent.hpp"
+#include "persistent.hpp"
+#include "mapped.hpp"
+#include "compact.hpp"
 #include <map>
 #include <chrono>
 #include <fstream>
 #include <random>
 #include <algorithm>
+#include <array>
 #include <numeric>
+#include <string>
+#include <string_view>
+#include <cstdlib>
+#include <cstdio>
+#include <new>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
 
 
-int main(){
+unsigned int n_start{1000};	// starting number of nodes in the tree
+unsigned int n_max{100000};	// maximum number of nodes in the tree
+unsigned int n_incr{1000};	// increment
+unsigned int n_measures{50};  	// number of measures for each step
 
-  unsigned int n_start{1000};	// starting number of nodes in the tree
-  unsigned int n_max{100000};	// maximum number of nodes in the tree
-  unsigned int n_incr{1000};	// increment
-  unsigned int n_measures{50};  // number of measures for each step
+volatile std::size_t found{0};	// keeps the look-ups from being optimised away
+
+std::atomic<std::size_t> allocations{0};	// number of calls to operator new
+
+std::atomic<std::size_t> heap_bytes{0};		// bytes of the blocks currently allocated
+
+
+// ======================== ALLOCATION COUNTER =========================
+//
+// The global operator new is replaced by one that counts its calls, in
+// order to measure the allocations performed by the look-ups, and the
+// bytes of the blocks it returns (as given by glibc, without the header
+// of each block), in order to measure the memory taken by a container.
+// The overaligned versions, used e.g. by the nodes of btree, are replaced
+// as well. The counters are atomic, since the parallel benchmarks
+// allocate from several threads. Without glibc the size of a block
+// cannot be told from its address, so heap_bytes stays 0.
+// The operators are not inlined, otherwise gcc sees free() called on
+// memory returned by operator new and warns about a mismatch.
+
+#if defined(__GNUC__)
+#define NOINLINE __attribute__((noinline))
+#else
+#define NOINLINE
+#endif
+
+// bytes of the block p, 0 if they cannot be known
+inline std::size_t block_bytes([[maybe_unused]] void* p) noexcept{
+
+#if defined(__GLIBC__)
+  return malloc_usable_size(p);
+#else
+  return 0;
+#endif
+}
+
+// counts a block just obtained, p may be nullptr
+inline void* counted(void* p){
+
+  if(!p){ throw std::bad_alloc{}; }
+
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  heap_bytes.fetch_add(block_bytes(p), std::memory_order_relaxed);
+  return p;
+}
+
+NOINLINE void* operator new(std::size_t size){ return counted(std::malloc(size ? size : 1)); }
+
+NOINLINE void* operator new(std::size_t size, std::align_val_t align){
+
+  std::size_t a{static_cast<std::size_t>(align)};
+
+  // aligned_alloc wants a size multiple of the alignment
+  return counted(std::aligned_alloc(a, size ? (size + a - 1) / a * a : a));
+}
+
+NOINLINE void operator delete(void* p) noexcept{
+
+  if(!p){ return; }
+
+  heap_bytes.fetch_sub(block_bytes(p), std::memory_order_relaxed);
+  std::free(p);
+}
+
+NOINLINE void operator delete(void* p, std::size_t) noexcept{ operator delete(p); }
+
+NOINLINE void operator delete(void* p, std::align_val_t) noexcept{ operator delete(p); }
+
+NOINLINE void operator delete(void* p, std::size_t, std::align_val_t) noexcept{ operator delete(p); }
+
+
+// ============================ TIME FINDS =============================
+//
+// Looks for all the given values in the container, divided in chunks of
+// n_measures, and returns the mean time (in ns) needed for a chunk.
+
+template<typename T, typename V>
+double time_finds(const T& container, const std::vector<V>& values){
+
+  double mean{0};
+
+  for(unsigned int j = 1; j <= values.size()/n_measures; ++j){
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+      for( unsigned int k = (j-1)*n_measures; k<j*n_measures; ++k){
+
+        if(container.find(values[k]) != container.end()){ ++found; }
+      }
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    mean += std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+  }
+
+  return mean/(values.size()/n_measures);
+}
+
+
+// =========================== TIME INSERTS ============================
+//
+// Inserts all the given values in the (empty) container and returns the
+// mean time (in ns) needed for a chunk of n_measures insertions.
+
+template<typename T>
+double time_inserts(T& container, const std::vector<int>& values){
+
+  auto start = std::chrono::high_resolution_clock::now();
+
+  for(const auto& j : values){
+
+    container.insert(std::pair<int, int>{j,j});
+  }
+
+  auto end = std::chrono::high_resolution_clock::now();
+
+  return double(std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count())/values.size()*n_measures;
+}
+
+
+// ========================== FIND BENCHMARK ===========================
+//
+// Compares the time needed to find the keys in the unbalanced and in the
+// balanced tree and in its frozen snapshot with the one of std::map.
+
+void find_benchmark(){
 
   // open files
   std::ofstream outfile_tree;
   std::ofstream outfile_balanced;
   std::ofstream outfile_map;
- 
+  std::ofstream outfile_frozen;
+
   outfile_tree.open("src/benchmark_results/unbalanced_bst.txt");
   outfile_balanced.open("src/benchmark_results/balanced_bst.txt");
   outfile_map.open("src/benchmark_results/map.txt");
+  outfile_frozen.open("src/benchmark_results/frozen_bst.txt");
 
   // loop on the number of nodes
 
@@ -40,7 +185,7 @@ int main(){
 
     std::shuffle(values.begin(), values.end(), g);  //randomize vector
 
-    // ========== BST ==========    
+    // ========== BST ==========
 
     bst<int, int> tree{};         	// empty binary search tree
 
@@ -51,7 +196,7 @@ int main(){
       tree.insert(pair);		// insert pairs
     }
 
-    
+
     // ========== BALANCED BST =========
 
     bst<int, int> balanced_tree{tree};
@@ -59,6 +204,11 @@ int main(){
     balanced_tree.balance();		// balance the tree
 
 
+    // ========== FROZEN BST =========
+
+    auto frozen_tree = balanced_tree.freeze();
+
+
     // ========== STD MAP ==========
 
     std::map<int, int> map{};
@@ -70,79 +220,1548 @@ int main(){
      map.insert(pair);
     }
 
-    
+
     std::shuffle(values.begin(), values.end(), g);  //randomize again vector
 
-    
+
     // measure the time:
 
-    double treemean{0};
-    
-    for(unsigned int j = 1; j <= i/n_measures; ++j){
-    
-      auto treestart = std::chrono::high_resolution_clock::now();
-    
-        for( unsigned int k = (j-1)*n_measures; k<j*n_measures; ++k){
-    
-          tree.find(values[k]);
-        }
-    
-     auto treeend = std::chrono::high_resolution_clock::now();
-    
-     treemean += std::chrono::duration_cast<std::chrono::nanoseconds>(treeend-treestart).count();
+    outfile_tree<< "\n" << i << "\t" << time_finds(tree, values);
+
+    outfile_balanced << "\n" << i << "\t" << time_finds(balanced_tree, values);
+
+    outfile_map<< "\n" << i << "\t" << time_finds(map, values);
+
+    outfile_frozen<< "\n" << i << "\t" << time_finds(frozen_tree, values);
+
+    outfile_tree << std::endl;
+    outfile_balanced << std::endl;
+    outfile_map << std::endl;
+    outfile_frozen << std::endl;
+
+  }
+
+  outfile_tree.close();
+  outfile_balanced.close();
+  outfile_map.close();
+  outfile_frozen.close();
+}
+
+
+// ======================= ALLOCATION BENCHMARK ========================
+//
+// Compares insertions and look-ups in a tree whose nodes are allocated
+// one by one with std::allocator and in a tree whose nodes come from a
+// pool_allocator. Columns: number of nodes, insertion time with the
+// default and with the pooled allocation, find time with the default and
+// with the pooled allocation (all for a chunk of n_measures operations).
+
+void allocation_benchmark(){
+
+  std::ofstream outfile;
+  outfile.open("src/benchmark_results/allocation.txt");
+
+  for(unsigned int i{n_start}; i<=n_max; i += n_incr){
+
+    std::vector<int> values(i);
+
+    std::iota(std::begin(values), std::end(values), 1);
+
+    std::random_device rd;
+    std::mt19937 g(rd());
+
+    std::shuffle(values.begin(), values.end(), g);
+
+    bst<int, int> tree{};
+    bst<int, int, std::less<int>, pool_allocator<std::pair<const int, int>>> pooled_tree{};
+
+    double tree_insert{time_inserts(tree, values)};
+    double pooled_insert{time_inserts(pooled_tree, values)};
+
+    std::shuffle(values.begin(), values.end(), g);
+
+    outfile << "\n" << i << "\t" << tree_insert << "\t" << pooled_insert;
+    outfile << "\t" << time_finds(tree, values) << "\t" << time_finds(pooled_tree, values) << std::endl;
+  }
+
+  outfile.close();
+}
+
+
+// ===================== SELF-BALANCING BENCHMARK ======================
+//
+// Compares the unbalanced tree with the red-black one, without ever
+// calling balance(). Columns: number of nodes, insertion time in the
+// unbalanced and in the red-black tree, find time in the unbalanced and
+// in the red-black tree (keys inserted in random order), insertion and
+// find time in the red-black tree with keys inserted in increasing order
+// (all for a chunk of n_measures operations). The unbalanced tree is not
+// measured on sorted input, where it degenerates into a list.
+
+void self_balancing_benchmark(){
+
+  std::ofstream outfile;
+  outfile.open("src/benchmark_results/self_balancing.txt");
+
+  for(unsigned int i{n_start}; i<=n_max; i += n_incr){
+
+    std::vector<int> values(i);
+
+    std::iota(std::begin(values), std::end(values), 1);
+
+    std::random_device rd;
+    std::mt19937 g(rd());
+
+    rb_bst<int, int> sorted_tree{};
+
+    double sorted_insert{time_inserts(sorted_tree, values)};
+
+    std::shuffle(values.begin(), values.end(), g);
+
+    bst<int, int> tree{};
+    rb_bst<int, int> rb_tree{};
+
+    double tree_insert{time_inserts(tree, values)};
+    double rb_insert{time_inserts(rb_tree, values)};
+
+    std::shuffle(values.begin(), values.end(), g);
+
+    outfile << "\n" << i << "\t" << tree_insert << "\t" << rb_insert;
+    outfile << "\t" << time_finds(tree, values) << "\t" << time_finds(rb_tree, values);
+    outfile << "\t" << sorted_insert << "\t" << time_finds(sorted_tree, values) << std::endl;
+  }
+
+  outfile.close();
+}
+
+
+// ======================== BULK LOAD BENCHMARK ========================
+//
+// Compares the ways of building a tree out of sorted data. Columns:
+// number of nodes, time to insert the pairs one by one (in random order,
+// since in sorted order the unbalanced tree degenerates into a list) and
+// then balance the tree, time of the sorted_unique range constructor,
+// time of the plain range constructor and time of the range constructor
+// of std::map (all for a chunk of n_measures pairs).
+
+void bulk_load_benchmark(){
+
+  std::ofstream outfile;
+  outfile.open("src/benchmark_results/bulk_load.txt");
+
+  for(unsigned int i{n_start}; i<=n_max; i += n_incr){
+
+    std::vector<std::pair<int, int>> pairs(i);
+
+    for(unsigned int j{0}; j < i; ++j){ pairs[j] = std::make_pair(j+1, j+1); }
+
+    std::vector<std::pair<int, int>> shuffled{pairs};
+
+    std::random_device rd;
+    std::mt19937 g(rd());
+
+    std::shuffle(shuffled.begin(), shuffled.end(), g);
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    bst<int, int> tree{};
+
+    for(const auto& j : shuffled){ tree.insert(j); }
+
+    tree.balance();
+
+    auto insert_end = std::chrono::high_resolution_clock::now();
+
+    bst<int, int> sorted_tree{sorted_unique, pairs.begin(), pairs.end()};
+
+    auto sorted_end = std::chrono::high_resolution_clock::now();
+
+    bst<int, int> range_tree{pairs.begin(), pairs.end()};
+
+    auto range_end = std::chrono::high_resolution_clock::now();
+
+    std::map<int, int> map{pairs.begin(), pairs.end()};
+
+    auto map_end = std::chrono::high_resolution_clock::now();
+
+    double chunks{double(i)/n_measures};
+
+    outfile << "\n" << i;
+    outfile << "\t" << std::chrono::duration_cast<std::chrono::nanoseconds>(insert_end-start).count()/chunks;
+    outfile << "\t" << std::chrono::duration_cast<std::chrono::nanoseconds>(sorted_end-insert_end).count()/chunks;
+    outfile << "\t" << std::chrono::duration_cast<std::chrono::nanoseconds>(range_end-sorted_end).count()/chunks;
+    outfile << "\t" << std::chrono::duration_cast<std::chrono::nanoseconds>(map_end-range_end).count()/chunks;
+    outfile << std::endl;
+  }
+
+  outfile.close();
+}
+
+
+// ======================= DESCENDING BENCHMARK ========================
+//
+// Measures the time needed to read the n_measures largest keys. Columns:
+// number of nodes, time of a descending scan from rbegin(), time of a
+// forward scan of the whole tree keeping the last keys seen (the only
+// way before reverse iterators were available) and time of a descending
+// scan of std::map.
+
+template<typename T>
+double time_descending(const T& container){
+
+  auto start = std::chrono::high_resolution_clock::now();
+
+  auto it = container.rbegin();
+
+  for(unsigned int k{0}; k < n_measures && it != container.rend(); ++k, ++it){ found += it->first; }
+
+  auto end = std::chrono::high_resolution_clock::now();
+
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+}
+
+void descending_benchmark(){
+
+  std::ofstream outfile;
+  outfile.open("src/benchmark_results/descending.txt");
+
+  for(unsigned int i{n_start}; i<=n_max; i += n_incr){
+
+    std::vector<int> values(i);
+
+    std::iota(std::begin(values), std::end(values), 1);
+
+    std::random_device rd;
+    std::mt19937 g(rd());
+
+    std::shuffle(values.begin(), values.end(), g);
+
+    bst<int, int> tree{};
+    std::map<int, int> map{};
+
+    for(const auto& j : values){
+
+      tree.insert(std::pair<int, int>{j,j});
+      map.insert(std::pair<int, int>{j,j});
     }
 
-    outfile_tree<< "\n" << i << "\t" << treemean/(i/n_measures);
+    double tree_descending{time_descending(tree)};
 
+    auto start = std::chrono::high_resolution_clock::now();
 
+    std::vector<int> last(n_measures);		// ring buffer with the last keys seen
+    unsigned int k{0};
 
+    for(const auto& j : tree){ last[k++ % n_measures] = j.first; }
 
-    double balancedmean{0};
-    
-    for(unsigned int j = 1; j <= i/n_measures; ++j){
+    found += last[0];
 
-      auto balancedstart = std::chrono::high_resolution_clock::now();
+    auto end = std::chrono::high_resolution_clock::now();
 
-        for( unsigned int k = (j-1)*n_measures; k<j*n_measures; ++k){
+    outfile << "\n" << i << "\t" << tree_descending;
+    outfile << "\t" << std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+    outfile << "\t" << time_descending(map) << std::endl;
+  }
 
-          balanced_tree.find(values[k]);
-        }
+  outfile.close();
+}
+
+
+// ========================== BTREE BENCHMARK ==========================
+//
+// Compares look-ups in the red-black tree, in the B-tree and in std::map
+// on trees that do not fit in the cache, doubling the number of keys from
+// 2^16 to 2^22. The B-tree is timed twice: with std::less, which uses the
+// SIMD key search the build was compiled for (AVX2 with the default
+// -march=native, SSE2 with `make ARCH=`), and with a comparison operator
+// of its own, which falls back to the scalar loop. Columns: number of
+// nodes, find time in the red-black tree, in the B-tree, in the B-tree
+// with the scalar search and in std::map (for a chunk of n_measures finds).
+
+// same order as std::less, but not recognised by _key_search
+struct scalar_less{
+
+  bool operator()(int a, int b) const noexcept{ return a < b; }
+};
+
+void btree_benchmark(){
+
+  std::ofstream outfile;
+  outfile.open("src/benchmark_results/btree.txt");
+
+  for(unsigned int i{1u << 16}; i <= (1u << 22); i *= 2){
+
+    std::vector<int> values(i);
+
+    std::iota(std::begin(values), std::end(values), 1);
 
-     auto balancedend = std::chrono::high_resolution_clock::now();
-     
-     balancedmean += std::chrono::duration_cast<std::chrono::nanoseconds>(balancedend-balancedstart).count();
+    std::random_device rd;
+    std::mt19937 g(rd());
+
+    std::shuffle(values.begin(), values.end(), g);
+
+    rb_bst<int, int> rb_tree{};
+    btree<int, int> b_tree{};
+    btree<int, int, scalar_less> scalar_tree{};
+    std::map<int, int> map{};
+
+    for(const auto& j : values){
+
+      rb_tree.insert(std::pair<int, int>{j,j});
+      b_tree.insert(std::pair<int, int>{j,j});
+      scalar_tree.insert(std::pair<int, int>{j,j});
+      map.insert(std::pair<int, int>{j,j});
     }
-    
-    outfile_balanced << "\n" << i << "\t" << balancedmean/(i/n_measures);
 
+    std::shuffle(values.begin(), values.end(), g);
+
+    outfile << "\n" << i << "\t" << time_finds(rb_tree, values);
+    outfile << "\t" << time_finds(b_tree, values) << "\t" << time_finds(scalar_tree, values);
+    outfile << "\t" << time_finds(map, values) << std::endl;
+  }
+
+  outfile.close();
+}
 
 
-    double mapmean{0};
-    
-    for(unsigned int j = 1; j <= i/n_measures; ++j){
-      
-      auto mapstart = std::chrono::high_resolution_clock::now();
-        
-        for( unsigned int k = (j-1)*n_measures; k<j*n_measures; ++k){
-          
-          map.find(values[k]);
-        }
-     
-     auto mapend = std::chrono::high_resolution_clock::now();
-     
-     mapmean += std::chrono::duration_cast<std::chrono::nanoseconds>(mapend-mapstart).count();
+// ======================== FIND MANY BENCHMARK ========================
+//
+// Compares looking for keys one by one with find() and in batches with
+// find_many() in a balanced tree of 2^20 nodes, which does not fit in the
+// cache, for batch sizes from 1 to 64. Columns: batch size, time per key
+// of find() and time per key of find_many() (in ns).
+
+void find_many_benchmark(){
+
+  std::ofstream outfile;
+  outfile.open("src/benchmark_results/find_many.txt");
+
+  const unsigned int n{1u << 20};
+
+  std::vector<int> values(n);
+
+  std::iota(std::begin(values), std::end(values), 1);
+
+  std::random_device rd;
+  std::mt19937 g(rd());
+
+  std::shuffle(values.begin(), values.end(), g);
+
+  bst<int, int> tree{};
+
+  for(const auto& j : values){ tree.insert(std::pair<int, int>{j,j}); }
+
+  tree.balance();
+
+  std::vector<bst<int, int>::iterator> results(64);
+
+  for(unsigned int batch{1}; batch <= 64; ++batch){
+
+    std::shuffle(values.begin(), values.end(), g);
+
+    unsigned int n_batches{n/batch};
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for(unsigned int b{0}; b < n_batches; ++b){
+
+      for(unsigned int k{b*batch}; k < (b+1)*batch; ++k){
+
+        results[k-b*batch] = tree.find(values[k]);
+      }
+
+      found += results[0] != tree.end();
     }
-    
-    outfile_map<< "\n" << i << "\t" << mapmean/(i/n_measures);
 
-    outfile_tree << std::endl;
-    outfile_balanced << std::endl;
-    outfile_map << std::endl;
+    auto single_end = std::chrono::high_resolution_clock::now();
+
+    for(unsigned int b{0}; b < n_batches; ++b){
+
+      tree.find_many(values.begin() + b*batch, values.begin() + (b+1)*batch, results.begin());
+
+      found += results[0] != tree.end();
+    }
+
+    auto many_end = std::chrono::high_resolution_clock::now();
+
+    double keys{double(n_batches)*batch};
 
+    outfile << "\n" << batch;
+    outfile << "\t" << std::chrono::duration_cast<std::chrono::nanoseconds>(single_end-start).count()/keys;
+    outfile << "\t" << std::chrono::duration_cast<std::chrono::nanoseconds>(many_end-single_end).count()/keys;
+    outfile << std::endl;
+  }
+
+  outfile.close();
+}
+
+
+// ======================= STRING KEYS BENCHMARK =======================
+//
+// Looks for std::string keys in a tree with the default comparison
+// operator, given as const char*, from which a temporary std::string is
+// built for each look-up, and in a tree with the transparent std::less<>,
+// given as std::string_view, which is compared directly with the keys.
+// The keys are long enough not to fit in the small string buffer, so
+// that each temporary std::string allocates. Columns:
+// number of nodes, find time with std::less<std::string> and with
+// std::less<> (for a chunk of n_measures finds), allocations per find
+// with std::less<std::string> and with std::less<>.
+
+void string_keys_benchmark(){
+
+  std::ofstream outfile;
+  outfile.open("src/benchmark_results/string_keys.txt");
+
+  for(unsigned int i{n_start}; i<=n_max; i += n_incr){
+
+    std::vector<std::string> keys(i);
+
+    for(unsigned int j{0}; j < i; ++j){ keys[j] = "benchmark_key_" + std::to_string(1000000 + j); }
+
+    std::random_device rd;
+    std::mt19937 g(rd());
+
+    std::shuffle(keys.begin(), keys.end(), g);
+
+    bst<std::string, int> tree{};
+    bst<std::string, int, std::less<>> transparent_tree{};
+
+    for(const auto& j : keys){
+
+      tree.insert(std::pair<std::string, int>{j, 0});
+      transparent_tree.insert(std::pair<std::string, int>{j, 0});
+    }
+
+    std::shuffle(keys.begin(), keys.end(), g);
+
+    std::vector<const char*> values(i);
+
+    for(unsigned int j{0}; j < i; ++j){ values[j] = keys[j].c_str(); }
+
+    std::vector<std::string_view> views(keys.begin(), keys.end());
+
+    std::size_t before{allocations};
+    double tree_find{time_finds(tree, values)};
+    std::size_t tree_allocations{allocations - before};
+
+    before = allocations;
+    double transparent_find{time_finds(transparent_tree, views)};
+    std::size_t transparent_allocations{allocations - before};
+
+    outfile << "\n" << i << "\t" << tree_find << "\t" << transparent_find;
+    outfile << "\t" << double(tree_allocations)/i << "\t" << double(transparent_allocations)/i << std::endl;
+  }
+
+  outfile.close();
+}
+
+
+// ======================= RANGE SCAN BENCHMARK ========================
+//
+// Measures queries for all the keys in [lo, hi) on a balanced tree of
+// n_max nodes, for ranges holding from 0.01% to 50% of the keys.
+// Columns: fraction of the keys in the range, number of keys in the
+// range, time per query of for_each_in_range(), of a scan of the whole
+// tree from begin() filtering the keys and of a scan of std::map from
+// lower_bound() (in ns).
+
+void range_scan_benchmark(){
+
+  std::ofstream outfile;
+  outfile.open("src/benchmark_results/range_scan.txt");
+
+  std::vector<int> values(n_max);
+
+  std::iota(std::begin(values), std::end(values), 1);
+
+  std::random_device rd;
+  std::mt19937 g(rd());
+
+  std::shuffle(values.begin(), values.end(), g);
+
+  bst<int, int> tree{};
+  std::map<int, int> map{};
+
+  for(const auto& j : values){
+
+    tree.insert(std::pair<int, int>{j,j});
+    map.insert(std::pair<int, int>{j,j});
+  }
+
+  tree.balance();
+
+  for(double fraction : {0.0001, 0.001, 0.01, 0.1, 0.5}){
+
+    int width{int(fraction*n_max)};
+
+    std::vector<int> lows(n_measures);
+
+    for(auto& lo : lows){ lo = 1 + int(g() % (n_max - width)); }
+
+    std::size_t sum{0};
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for(const auto& lo : lows){
+
+      tree.for_each_in_range(lo, lo + width, [&sum](const std::pair<const int, int>& p){ sum += p.second; });
+    }
+
+    auto range_end = std::chrono::high_resolution_clock::now();
+
+    for(const auto& lo : lows){
+
+      for(const auto& p : tree){
+
+        if(p.first >= lo && p.first < lo + width){ sum += p.second; }
+      }
+    }
+
+    auto filter_end = std::chrono::high_resolution_clock::now();
+
+    for(const auto& lo : lows){
+
+      for(auto it = map.lower_bound(lo); it != map.end() && it->first < lo + width; ++it){ sum += it->second; }
+    }
+
+    auto map_end = std::chrono::high_resolution_clock::now();
+
+    found += sum;
+
+    outfile << "\n" << fraction << "\t" << width;
+    outfile << "\t" << std::chrono::duration_cast<std::chrono::nanoseconds>(range_end-start).count()/double(n_measures);
+    outfile << "\t" << std::chrono::duration_cast<std::chrono::nanoseconds>(filter_end-range_end).count()/double(n_measures);
+    outfile << "\t" << std::chrono::duration_cast<std::chrono::nanoseconds>(map_end-filter_end).count()/double(n_measures);
+    outfile << std::endl;
+  }
+
+  outfile.close();
+}
+
+
+// ==================== ORDER STATISTICS BENCHMARK =====================
+//
+// Measures the cost of keeping the size of the subtrees in the nodes and
+// what it buys. Columns: number of nodes, insertion time in the
+// unbalanced tree, in the red-black tree and in std::map (for a chunk of
+// n_measures insertions, keys in random order), time to find the median
+// with nth() and by walking from begin() as the only way without
+// the sizes, on the red-black tree (in ns).
+
+void order_statistics_benchmark(){
+
+  std::ofstream outfile;
+  outfile.open("src/benchmark_results/order_statistics.txt");
+
+  for(unsigned int i{n_start}; i<=n_max; i += n_incr){
+
+    std::vector<int> values(i);
+
+    std::iota(std::begin(values), std::end(values), 1);
+
+    std::random_device rd;
+    std::mt19937 g(rd());
+
+    std::shuffle(values.begin(), values.end(), g);
+
+    bst<int, int> tree{};
+    rb_bst<int, int> rb_tree{};
+    std::map<int, int> map{};
+
+    double tree_insert{time_inserts(tree, values)};
+    double rb_insert{time_inserts(rb_tree, values)};
+    double map_insert{time_inserts(map, values)};
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    found += rb_tree.nth(i/2)->first;
+
+    auto nth_end = std::chrono::high_resolution_clock::now();
+
+    found += std::next(rb_tree.cbegin(), i/2)->first;
+
+    auto walk_end = std::chrono::high_resolution_clock::now();
+
+    outfile << "\n" << i << "\t" << tree_insert << "\t" << rb_insert << "\t" << map_insert;
+    outfile << "\t" << std::chrono::duration_cast<std::chrono::nanoseconds>(nth_end-start).count();
+    outfile << "\t" << std::chrono::duration_cast<std::chrono::nanoseconds>(walk_end-nth_end).count();
+    outfile << std::endl;
+  }
+
+  outfile.close();
+}
+
+
+// ======================= HEAVY VALUES BENCHMARK ======================
+//
+// Uses a value type whose construction allocates a buffer and which
+// carries an inline payload that a move has to copy, to measure the
+// constructions and moves saved by try_emplace. The tree is filled through
+// emplace(key, heavy(size)), which builds a temporary pair and moves it
+// in the node, and through try_emplace(key, size), which constructs the
+// value in the node; then every key is accessed again with the former
+// operator[], i.e. emplace(key, heavy()), which builds a value to throw
+// it away, and with the current one, based on try_emplace. Columns:
+// number of nodes, fill time with emplace and with try_emplace, access
+// time with the former and the current operator[] and with the one of
+// std::map (for a chunk of n_measures operations), allocations per
+// access with the former and the current operator[].
+
+struct heavy{
+
+  std::vector<double> data;		// buffer allocated by every ctor
+
+  std::array<double, 32> stats;		// inline payload, copied by a move
+
+  heavy(): data(32), stats{} {}
+  explicit heavy(std::size_t n): data(n), stats{} {}
+};
+
+template<typename F>
+double time_chunks(const std::vector<int>& values, F f){
+
+  auto start = std::chrono::high_resolution_clock::now();
+
+  for(const auto& j : values){ f(j); }
+
+  auto end = std::chrono::high_resolution_clock::now();
+
+  return double(std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count())/values.size()*n_measures;
+}
+
+void heavy_values_benchmark(){
+
+  std::ofstream outfile;
+  outfile.open("src/benchmark_results/heavy_values.txt");
+
+  for(unsigned int i{n_start}; i<=n_max; i += n_incr){
+
+    std::vector<int> values(i);
+
+    std::iota(std::begin(values), std::end(values), 1);
+
+    std::random_device rd;
+    std::mt19937 g(rd());
+
+    std::shuffle(values.begin(), values.end(), g);
+
+    rb_bst<int, heavy> emplaced{};
+    rb_bst<int, heavy> tree{};
+    std::map<int, heavy> map{};
+
+    double emplace_fill{time_chunks(values, [&](int k){ emplaced.emplace(k, heavy(32)); })};
+    double try_emplace_fill{time_chunks(values, [&](int k){ tree.try_emplace(k, 32); })};
+
+    for(const auto& j : values){ map.try_emplace(j, 32); }
+
+    std::shuffle(values.begin(), values.end(), g);
+
+    std::size_t before{allocations};
+    double old_access{time_chunks(values, [&](int k){ emplaced.emplace(k, heavy()).first->second.data[0] += 1; })};
+    std::size_t old_allocations{allocations - before};
+
+    before = allocations;
+    double new_access{time_chunks(values, [&](int k){ tree[k].data[0] += 1; })};
+    std::size_t new_allocations{allocations - before};
+
+    double map_access{time_chunks(values, [&](int k){ map[k].data[0] += 1; })};
+
+    outfile << "\n" << i << "\t" << emplace_fill << "\t" << try_emplace_fill;
+    outfile << "\t" << old_access << "\t" << new_access << "\t" << map_access;
+    outfile << "\t" << double(old_allocations)/i << "\t" << double(new_allocations)/i << std::endl;
+  }
+
+  outfile.close();
+}
+
+
+// ======================= SORTED INPUT BENCHMARK ======================
+//
+// Builds a red-black tree and a std::map out of increasing keys, and a
+// red-black tree out of nearly increasing keys (increasing keys shuffled
+// in windows of 8), inserting each key from the root and with end() as
+// hint. The unbalanced tree is left out: increasing keys turn it into a
+// list, with or without hints. Columns: number of nodes, then for a
+// chunk of n_measures insertions the time of the plain and of the hinted
+// insertion in the red-black tree and in std::map with increasing keys,
+// and in the red-black tree with nearly increasing keys.
+
+void sorted_input_benchmark(){
+
+  std::ofstream outfile;
+  outfile.open("src/benchmark_results/sorted_input.txt");
+
+  for(unsigned int i{n_start}; i<=n_max; i += n_incr){
+
+    std::vector<int> values(i);
+
+    std::iota(std::begin(values), std::end(values), 1);
+
+    std::vector<int> near(values);
+
+    std::random_device rd;
+    std::mt19937 g(rd());
+
+    for(unsigned int j{0}; j < i; j += 8){ std::shuffle(near.begin() + j, near.begin() + std::min(j+8, i), g); }
+
+    rb_bst<int, int> plain{}, hinted{}, near_plain{}, near_hinted{};
+    std::map<int, int> map_plain{}, map_hinted{};
+
+    double tree_plain{time_chunks(values, [&](int k){ plain.insert(std::pair<int, int>{k, k}); })};
+    double tree_hinted{time_chunks(values, [&](int k){ hinted.insert(hinted.end(), std::pair<int, int>{k, k}); })};
+    double map_plain_time{time_chunks(values, [&](int k){ map_plain.insert(std::pair<int, int>{k, k}); })};
+    double map_hinted_time{time_chunks(values, [&](int k){ map_hinted.insert(map_hinted.end(), std::pair<int, int>{k, k}); })};
+    double near_plain_time{time_chunks(near, [&](int k){ near_plain.insert(std::pair<int, int>{k, k}); })};
+    double near_hinted_time{time_chunks(near, [&](int k){ near_hinted.insert(near_hinted.end(), std::pair<int, int>{k, k}); })};
+
+    outfile << "\n" << i << "\t" << tree_plain << "\t" << tree_hinted << "\t" << map_plain_time << "\t" << map_hinted_time;
+    outfile << "\t" << near_plain_time << "\t" << near_hinted_time << std::endl;
+  }
+
+  outfile.close();
+}
+
+
+// ======================= NODE HANDLES BENCHMARK ======================
+//
+// Moves the older half of the entries of a "hot" red-black tree (the
+// smaller keys) into a "cold" one holding other keys, with std::string
+// values too long for the small string optimisation, in three ways:
+// find, copy of the pair into the cold tree and erase from the hot one;
+// extract from the hot tree and insert of the node handle; merge of a
+// hot tree holding only the older entries. Columns: number of entries
+// moved, time per entry moved and allocations per entry moved with
+// copies, with node handles and with merge.
+
+void node_handles_benchmark(){
+
+  std::ofstream outfile;
+  outfile.open("src/benchmark_results/node_handles.txt");
+
+  const std::string payload(40, 'v');
+
+  for(unsigned int i{n_start}; i<=n_max; i += n_incr){
+
+    std::vector<int> values(2*i);
+
+    std::iota(std::begin(values), std::end(values), 1);
+
+    std::random_device rd;
+    std::mt19937 g(rd());
+
+    std::shuffle(values.begin(), values.end(), g);
+
+    using tree_type = rb_bst<int, std::string>;
+
+    tree_type copy_hot{}, copy_cold{}, handle_hot{}, handle_cold{}, merge_hot{}, merge_cold{};
+
+    for(const auto& j : values){
+
+      // the keys up to i are moved, the cold trees hold negative keys
+      for(auto* t : {&copy_hot, &handle_hot}){ t->insert(std::pair<int, std::string>{j, payload}); }
+      if(j <= int(i)){ merge_hot.insert(std::pair<int, std::string>{j, payload}); }
+
+      for(auto* t : {&copy_cold, &handle_cold, &merge_cold}){ t->insert(std::pair<int, std::string>{-j, payload}); }
+    }
+
+    std::vector<int> moved(values);
+    moved.erase(std::remove_if(moved.begin(), moved.end(), [i](int k){ return k > int(i); }), moved.end());
+
+    std::size_t before{allocations};
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for(const auto& k : moved){
+
+      copy_cold.insert(*copy_hot.find(k));
+      copy_hot.erase(k);
+    }
+
+    auto copy_end = std::chrono::high_resolution_clock::now();
+    std::size_t copy_allocations{allocations - before};
+
+    for(const auto& k : moved){ handle_cold.insert(handle_hot.extract(k)); }
+
+    auto handle_end = std::chrono::high_resolution_clock::now();
+    std::size_t handle_allocations{allocations - before - copy_allocations};
+
+    merge_cold.merge(merge_hot);
+
+    auto merge_end = std::chrono::high_resolution_clock::now();
+    std::size_t merge_allocations{allocations - before - copy_allocations - handle_allocations};
+
+    outfile << "\n" << i;
+    outfile << "\t" << double(std::chrono::duration_cast<std::chrono::nanoseconds>(copy_end-start).count())/i;
+    outfile << "\t" << double(std::chrono::duration_cast<std::chrono::nanoseconds>(handle_end-copy_end).count())/i;
+    outfile << "\t" << double(std::chrono::duration_cast<std::chrono::nanoseconds>(merge_end-handle_end).count())/i;
+    outfile << "\t" << double(copy_allocations)/i << "\t" << double(handle_allocations)/i << "\t" << double(merge_allocations)/i << std::endl;
+  }
+
+  outfile.close();
+}
+
+
+// ====================== SET OPERATIONS BENCHMARK =====================
+//
+// Computes the union, intersection and difference of a red-black tree of
+// n keys with one of m keys, for m from 10 to n = 10*n_max, with the keys
+// drawn from a range of 4n values. The trees are moved into split/join
+// based set operations (the copies are made before starting the clock),
+// and compared with the iterator based std::set_union, std::set_
+// intersection and std::set_difference writing into a std::map, and, for
+// the union, with inserting the m keys one by one in a copy of the large
+// tree. Columns: m, then the time (in us) of the union with the set
+// operation, with std::set_union and with the insertions, of the
+// intersection and of the difference (large minus small) with the set
+// operation and with the std algorithm.
+
+void set_operations_benchmark(){
+
+  std::ofstream outfile;
+  outfile.open("src/benchmark_results/set_operations.txt");
+
+  using tree_type = rb_bst<int, int>;
+
+  const unsigned int n{10*n_max};
+
+  std::random_device rd;
+  std::mt19937 g(rd());
+  std::uniform_int_distribution<int> draw(0, 4*int(n));
+
+  tree_type large{};
+  std::map<int, int> large_map{};
+
+  while(large.size() < n){ int k{draw(g)}; large.insert(std::pair<int, int>{k, k}); large_map.emplace(k, k); }
+
+  auto less_key = [](const std::pair<const int, int>& a, const std::pair<const int, int>& b){ return a.first < b.first; };
+
+  auto elapsed = [](std::chrono::high_resolution_clock::time_point start){
+
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now()-start).count();
+  };
+
+  for(unsigned int m{10}; m <= n; m *= 10){
+
+    tree_type small{};
+    std::map<int, int> small_map{};
+
+    while(small.size() < m){ int k{draw(g)}; small.insert(std::pair<int, int>{k, k}); small_map.emplace(k, k); }
+
+    outfile << "\n" << m;
+
+    // union
+    tree_type a{large}, b{small}, c{large};
+
+    auto start = std::chrono::high_resolution_clock::now();
+    auto united = set_union(std::move(a), std::move(b));
+    outfile << "\t" << elapsed(start);
+    found += united.size();
+
+    std::map<int, int> result{};
+    start = std::chrono::high_resolution_clock::now();
+    std::set_union(large_map.begin(), large_map.end(), small_map.begin(), small_map.end(),
+                   std::inserter(result, result.end()), less_key);
+    outfile << "\t" << elapsed(start);
+
+    start = std::chrono::high_resolution_clock::now();
+    for(const auto& i : small){ c.insert(i); }
+    outfile << "\t" << elapsed(start);
+
+    // intersection
+    tree_type d{large}, e{small};
+    result.clear();
+
+    start = std::chrono::high_resolution_clock::now();
+    auto common = set_intersection(std::move(e), std::move(d));
+    outfile << "\t" << elapsed(start);
+    found += common.size();
+
+    start = std::chrono::high_resolution_clock::now();
+    std::set_intersection(small_map.begin(), small_map.end(), large_map.begin(), large_map.end(),
+                          std::inserter(result, result.end()), less_key);
+    outfile << "\t" << elapsed(start);
+
+    // difference
+    tree_type f{large}, h{small};
+    result.clear();
+
+    start = std::chrono::high_resolution_clock::now();
+    auto rest = set_difference(std::move(f), std::move(h));
+    outfile << "\t" << elapsed(start);
+    found += rest.size();
+
+    start = std::chrono::high_resolution_clock::now();
+    std::set_difference(large_map.begin(), large_map.end(), small_map.begin(), small_map.end(),
+                        std::inserter(result, result.end()), less_key);
+    outfile << "\t" << elapsed(start) << std::endl;
+  }
+
+  outfile.close();
+}
+
+
+// ====================== PARALLEL BUILD BENCHMARK =====================
+//
+// Builds a red-black tree out of 40*n_max pairs in random order, with
+// keys drawn from a range of as many values so that about a third of
+// them are duplicates, using the parallel range constructor with 1, 2,
+// 4, ... threads, up to 32 or the number of hardware threads if larger.
+// Columns: number of threads, build time (in ms), speedup over a single
+// thread, and time of the serial range constructor, which inserts the
+// pairs one by one and then balances the tree (measured once).
+
+void parallel_build_benchmark(){
+
+  std::ofstream outfile;
+  outfile.open("src/benchmark_results/parallel_build.txt");
+
+  using tree_type = rb_bst<int, int>;
+
+  const unsigned int n{40*n_max};
+
+  std::random_device rd;
+  std::mt19937 g(rd());
+  std::uniform_int_distribution<int> draw(0, int(n) - 1);
+
+  std::vector<std::pair<int, int>> pairs(n);
+
+  for(unsigned int i{0}; i < n; ++i){ pairs[i] = {draw(g), int(i)}; }
+
+  auto elapsed = [](std::chrono::high_resolution_clock::time_point start){
+
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now()-start).count();
+  };
+
+  auto start = std::chrono::high_resolution_clock::now();
+  tree_type serial(pairs.begin(), pairs.end());
+  auto serial_time = elapsed(start);
+  found += serial.size();
+
+  const std::size_t max_threads{std::max<std::size_t>(32, std::thread::hardware_concurrency())};
+  double single{0};
+
+  for(std::size_t threads{1}; threads <= max_threads; threads *= 2){
+
+    start = std::chrono::high_resolution_clock::now();
+    tree_type t(parallel_build, pairs.begin(), pairs.end(), threads);
+    auto time = elapsed(start);
+    found += t.size();
+
+    if(threads == 1){ single = time; }
+
+    outfile << "\n" << threads << "\t" << time << "\t" << (time ? single / time : 0) << "\t" << serial_time << std::endl;
+  }
+}
+
+
+// ======================= CONCURRENT BENCHMARK ========================
+//
+// Measures the throughput of threads sharing a red-black tree of 10*n_max
+// keys, each performing 100000 operations on random keys, a given share
+// of which are writes (an insertion or an erasure, half and half) and
+// the others look-ups. The concurrent_bst is compared with a tree guarded
+// by a std::mutex and with one guarded by a std::shared_mutex, read-
+// locked by the look-ups. The thread count doubles from 1 to 32, or to
+// the number of hardware threads if larger, and the write share goes
+// from 0% to 50%. Columns: number of threads, write share (in %), then
+// the throughput (in operations per us) of concurrent_bst, of the tree
+// with a std::mutex and of the tree with a std::shared_mutex.
+
+template<typename F>
+double throughput(std::size_t threads, unsigned int ops, F&& op){
+
+  std::vector<std::thread> pool;
+
+  auto start = std::chrono::high_resolution_clock::now();
+
+  for(std::size_t t{0}; t < threads; ++t){
+
+    pool.emplace_back([&op, t, ops](){
+
+      std::mt19937 g(t);
+
+      for(unsigned int i{0}; i < ops; ++i){ op(g); }
+    });
+  }
+
+  for(auto& t : pool){ t.join(); }
+
+  auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now()-start).count();
+
+  return double(threads) * ops / (time ? time : 1);
+}
+
+void concurrent_benchmark(){
+
+  std::ofstream outfile;
+  outfile.open("src/benchmark_results/concurrent.txt");
+
+  using tree_type = rb_bst<int, int>;
+
+  const unsigned int n{10*n_max};
+  const unsigned int ops{100000};
+
+  const std::size_t max_threads{std::max<std::size_t>(32, std::thread::hardware_concurrency())};
+
+  std::vector<std::pair<int, int>> pairs(n);
+
+  for(unsigned int i{0}; i < n; ++i){ pairs[i] = {2*int(i), int(i)}; }
+
+  for(std::size_t threads{1}; threads <= max_threads; threads *= 2){
+
+    for(unsigned int writes : {0, 1, 10, 50}){
+
+      // keys are drawn from twice the range of the tree, writes insert or
+      // erase odd keys so that the tree keeps about the same size
+      auto draw = [n, writes](std::mt19937& g, bool& write, int& key){
+
+        write = g() % 100 < writes;
+        key = int(g() % (2*n));
+      };
+
+      concurrent_bst<int, int> shared{tree_type(sorted_unique, pairs.begin(), pairs.end())};
+
+      double concurrent = throughput(threads, ops, [&](std::mt19937& g){
+
+        bool write; int key;
+        draw(g, write, key);
+
+        if(!write){ found += shared.contains(key); }
+        else if(key % 2){ shared.emplace(key, key); }
+        else{ shared.erase(key + 1); }
+      });
+
+      tree_type guarded(sorted_unique, pairs.begin(), pairs.end());
+      std::mutex m;
+
+      double mutex = throughput(threads, ops, [&](std::mt19937& g){
+
+        bool write; int key;
+        draw(g, write, key);
+
+        std::lock_guard<std::mutex> l{m};
+
+        if(!write){ found += guarded.find(key) != guarded.end(); }
+        else if(key % 2){ guarded.emplace(key, key); }
+        else{ guarded.erase(key + 1); }
+      });
+
+      tree_type shared_guarded(sorted_unique, pairs.begin(), pairs.end());
+      std::shared_mutex sm;
+
+      double shared_mutex = throughput(threads, ops, [&](std::mt19937& g){
+
+        bool write; int key;
+        draw(g, write, key);
+
+        if(!write){
+
+          std::shared_lock<std::shared_mutex> l{sm};
+          found += shared_guarded.find(key) != shared_guarded.end();
+
+        }else{
+
+          std::lock_guard<std::shared_mutex> l{sm};
+
+          if(key % 2){ shared_guarded.emplace(key, key); }
+          else{ shared_guarded.erase(key + 1); }
+        }
+      });
+
+      outfile << "\n" << threads << "\t" << writes << "\t" << concurrent << "\t" << mutex << "\t" << shared_mutex << std::endl;
+    }
+  }
+}
+
+
+// ======================= PERSISTENT BENCHMARK ========================
+//
+// Compares the persistent tree, whose updates copy the path from the
+// root, with the mutable red-black tree. The keys are inserted in random
+// order, looked up and then erased in another random order. Columns:
+// number of nodes, insertion time in the persistent and in the red-black
+// tree, find time in the persistent and in the red-black tree, erasure
+// time in the persistent tree, the same while a snapshot of the full
+// tree is held (so that no node is freed) and erasure time in the
+// red-black tree (all for a chunk of n_measures operations).
+
+void persistent_benchmark(){
+
+  std::ofstream outfile;
+  outfile.open("src/benchmark_results/persistent.txt");
+
+  for(unsigned int i{n_start}; i<=n_max; i += n_incr){
+
+    std::vector<int> values(i);
+
+    std::iota(std::begin(values), std::end(values), 1);
+
+    std::random_device rd;
+    std::mt19937 g(rd());
+
+    std::shuffle(values.begin(), values.end(), g);
+
+    persistent_bst<int, int> persistent{};
+    rb_bst<int, int> tree{};
+
+    double persistent_insert{time_inserts(persistent, values)};
+    double rb_insert{time_inserts(tree, values)};
+
+    std::shuffle(values.begin(), values.end(), g);
+
+    double persistent_find{time_finds(persistent, values)};
+    double rb_find{time_finds(tree, values)};
+
+    // while the snapshot is held the erasures free no node, then the
+    // snapshot is the only owner left and its erasures free the nodes
+    auto snapshot = persistent.snapshot();
+
+    double kept_erase{time_chunks(values, [&](int k){ persistent.erase(k); })};
+    double persistent_erase{time_chunks(values, [&](int k){ snapshot.erase(k); })};
+    double rb_erase{time_chunks(values, [&](int k){ tree.erase(k); })};
+
+    outfile << i << "\t" << persistent_insert << "\t" << rb_insert << "\t" << persistent_find << "\t" << rb_find
+            << "\t" << persistent_erase << "\t" << kept_erase << "\t" << rb_erase << std::endl;
+  }
+}
+
+
+// ===================== PARALLEL TRAVERSAL BENCHMARK ===================
+//
+// Sums the values of a red-black tree of 10 million nodes with
+// parallel_reduce() and increments them with parallel_for_each(), with 1,
+// 2, 4, ... threads, up to 32 or the number of hardware threads if
+// larger. Columns: number of threads, time (in ms) of parallel_reduce,
+// its speedup over a single thread, time of parallel_for_each, its
+// speedup over a single thread, and time of the serial sum with a
+// range-for loop (measured once).
+
+void parallel_traversal_benchmark(){
+
+  std::ofstream outfile;
+  outfile.open("src/benchmark_results/parallel_traversal.txt");
+
+  const unsigned int n{100*n_max};
+
+  std::vector<std::pair<int, long>> pairs(n);
+
+  for(unsigned int i{0}; i < n; ++i){ pairs[i] = {int(i), long(i)}; }
+
+  rb_bst<int, long> tree(sorted_unique, pairs.begin(), pairs.end());
+
+  pairs = {};
+
+  auto elapsed = [](std::chrono::high_resolution_clock::time_point start){
+
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now()-start).count();
+  };
+
+  auto start = std::chrono::high_resolution_clock::now();
+  long sum{0};
+  for(const auto& i : tree){ sum += i.second; }
+  auto serial_time = elapsed(start);
+  found += sum;
+
+  auto value = [](const std::pair<const int, long>& x){ return x.second; };
+  auto plus = [](long a, long b){ return a + b; };
+
+  const std::size_t max_threads{std::max<std::size_t>(32, std::thread::hardware_concurrency())};
+  double single_reduce{0}, single_for_each{0};
+
+  for(std::size_t threads{1}; threads <= max_threads; threads *= 2){
+
+    start = std::chrono::high_resolution_clock::now();
+    found += tree.parallel_reduce(0L, value, plus, threads);
+    auto reduce_time = elapsed(start);
+
+    start = std::chrono::high_resolution_clock::now();
+    tree.parallel_for_each([](std::pair<const int, long>& x){ ++x.second; }, threads);
+    auto for_each_time = elapsed(start);
+
+    if(threads == 1){ single_reduce = reduce_time; single_for_each = for_each_time; }
+
+    outfile << "\n" << threads << "\t" << reduce_time << "\t" << (reduce_time ? single_reduce / reduce_time : 0)
+            << "\t" << for_each_time << "\t" << (for_each_time ? single_for_each / for_each_time : 0) << "\t" << serial_time << std::endl;
+  }
+}
+
+
+// ========================= SAVE LOAD BENCHMARK ========================
+//
+// Compares the ways of getting back, e.g. at start-up, a red-black tree
+// of n pairs of integers, for n from 1 to 10 million: loading it from the
+// binary file written by save() and inserting the pairs one by one in
+// random order, as when the tree is rebuilt from its sources. Columns:
+// number of pairs, time (in ms) of save(), of load() and of the
+// insertions. The file is removed at the end.
+
+void save_load_benchmark(){
+
+  std::ofstream outfile;
+  outfile.open("src/benchmark_results/save_load.txt");
+
+  using tree_type = rb_bst<int, int>;
+
+  const std::string path{"src/benchmark_results/save_load.bin"};
+
+  std::random_device rd;
+  std::mt19937 g(rd());
+
+  auto elapsed = [](std::chrono::high_resolution_clock::time_point start){
+
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now()-start).count();
+  };
+
+  for(unsigned int n{10*n_max}; n <= 100*n_max; n += 10*n_max){
+
+    std::vector<int> values(n);
+
+    std::iota(std::begin(values), std::end(values), 0);
+    std::shuffle(values.begin(), values.end(), g);
+
+    tree_type inserted{};
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for(const auto& k : values){ inserted.insert(std::pair<const int, int>{k, k}); }
+    auto insert_time = elapsed(start);
+
+    start = std::chrono::high_resolution_clock::now();
+    inserted.save(path);
+    auto save_time = elapsed(start);
+
+    tree_type loaded{};
+
+    start = std::chrono::high_resolution_clock::now();
+    loaded.load(path);
+    auto load_time = elapsed(start);
+
+    found += loaded.size();
+
+    outfile << n << "\t" << save_time << "\t" << load_time << "\t" << insert_time << std::endl;
+  }
+
+  std::remove(path.c_str());
+}
+
+
+// ========================== MAPPED BENCHMARK =========================
+//
+// Compares opening a tree of n pairs of integers saved in a file, for n
+// from 1 to 8 million, by mapping it with mapped_bst and by reading it
+// with bst::load(), and then measures look-ups of random keys in the
+// mapped tree: cold, right after its pages have been evicted from the
+// page cache (with posix_fadvise, after flushing them to the disk), and
+// warm, repeating the same look-ups. Columns: number of pairs, time (in
+// us) to open the mapped tree, time (in us) of load(), cold find time and
+// warm find time in the mapped tree, find time in the red-black tree
+// (all for a chunk of n_measures finds). The files are removed at the end.
+
+void mapped_benchmark(){
+
+  std::ofstream outfile;
+  outfile.open("src/benchmark_results/mapped.txt");
+
+  const std::string mapped_path{"src/benchmark_results/mapped.bin"};
+  const std::string saved_path{"src/benchmark_results/saved.bin"};
+
+  std::random_device rd;
+  std::mt19937 g(rd());
+
+  auto elapsed = [](std::chrono::high_resolution_clock::time_point start){
+
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now()-start).count();
+  };
+
+  // flushes the file and drops its pages from the page cache
+  auto evict = [](const std::string& path){
+
+    int fd{open(path.c_str(), O_RDONLY)};
+
+    if(fd >= 0){
+
+      fdatasync(fd);
+      posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+      close(fd);
+    }
+  };
+
+  for(unsigned int n{10*n_max}; n <= 80*n_max; n *= 2){
+
+    std::vector<std::pair<int, int>> pairs(n);
+
+    for(unsigned int i{0}; i < n; ++i){ pairs[i] = {2*int(i), int(i)}; }
+
+    rb_bst<int, int> tree(sorted_unique, pairs.begin(), pairs.end());
+
+    pairs = {};
+
+    mapped_bst<int, int>::write(mapped_path, tree.freeze());
+    tree.save(saved_path);
+
+    std::vector<int> values(10*n_max);
+
+    for(auto& v : values){ v = int(g() % (2*n)); }
+
+    evict(mapped_path);
+    evict(saved_path);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    mapped_bst<int, int> mapped{mapped_path};
+    auto open_time = elapsed(start);
+
+    rb_bst<int, int> loaded{};
+
+    start = std::chrono::high_resolution_clock::now();
+    loaded.load(saved_path);
+    auto load_time = elapsed(start);
+
+    double cold{time_finds(mapped, values)};
+    double warm{time_finds(mapped, values)};
+    double heap{time_finds(loaded, values)};
+
+    outfile << n << "\t" << open_time << "\t" << load_time << "\t" << cold << "\t" << warm << "\t" << heap << std::endl;
+  }
+
+  std::remove(mapped_path.c_str());
+  std::remove(saved_path.c_str());
+}
+
+
+// ========================== COMPACT BENCHMARK ========================
+//
+// Compares the compact tree, whose nodes are kept in a vector and linked
+// by 32-bit indices, with the red-black tree, whose nodes are allocated
+// one by one and linked by pointers, for n from 1000 to 8 million keys
+// inserted in random order and then looked up in another random order.
+// Columns: number of nodes, bytes per node taken on the heap by the
+// red-black and by the compact tree (the latter with the spare capacity
+// of its vector), insertion time in the red-black and in the compact
+// tree, find time in the red-black and in the compact tree (all for a
+// chunk of n_measures operations).
+
+void compact_benchmark(){
+
+  std::ofstream outfile;
+  outfile.open("src/benchmark_results/compact.txt");
+
+  std::random_device rd;
+  std::mt19937 g(rd());
+
+  for(unsigned int i{n_start}; i <= 80*n_max; i *= 2){
+
+    std::vector<int> values(i);
+
+    std::iota(std::begin(values), std::end(values), 1);
+    std::shuffle(values.begin(), values.end(), g);
+
+    rb_bst<int, int> tree{};
+    compact_bst<int, int> compact{};
+
+    std::size_t before{heap_bytes};
+    double rb_insert{time_inserts(tree, values)};
+    double rb_bytes{double(heap_bytes - before)/i};
+
+    before = heap_bytes;
+    double compact_insert{time_inserts(compact, values)};
+    double compact_bytes{double(heap_bytes - before)/i};
+
+    std::shuffle(values.begin(), values.end(), g);
+
+    double rb_find{time_finds(tree, values)};
+    double compact_find{time_finds(compact, values)};
+
+    outfile << i << "\t" << rb_bytes << "\t" << compact_bytes << "\t" << rb_insert << "\t" << compact_insert
+            << "\t" << rb_find << "\t" << compact_find << std::endl;
+  }
+}
+
+
+// ======================== LARGE VALUES BENCHMARK =====================
+//
+// Compares look-ups with 200-byte values in the red-black tree, in the
+// compact tree with the values in its nodes and in the compact tree with
+// the values kept apart, for 1000 to 512000 keys inserted and then looked
+// up in random order. Columns: number of nodes, find time in the three
+// trees, and the same when the value found is read (all for a chunk of
+// n_measures finds).
+
+struct large_value{
+
+  int id;			// read on a hit
+
+  char payload[196];		// never read by a look-up
+};
+
+void large_values_benchmark(){
+
+  std::ofstream outfile;
+  outfile.open("src/benchmark_results/large_values.txt");
+
+  std::random_device rd;
+  std::mt19937 g(rd());
+
+  for(unsigned int i{n_start}; i <= 10*n_max; i *= 2){
+
+    std::vector<int> values(i);
+
+    std::iota(std::begin(values), std::end(values), 1);
+    std::shuffle(values.begin(), values.end(), g);
+
+    rb_bst<int, large_value> tree{};
+    compact_bst<int, large_value> in_nodes{};
+    compact_bst<int, large_value, std::less<int>, std::allocator<std::pair<const int, large_value>>, separate_values> apart{};
+
+    for(const auto& k : values){
+
+      tree.try_emplace(k, large_value{k, {}});
+      in_nodes.emplace(k, large_value{k, {}});
+      apart.emplace(k, large_value{k, {}});
+    }
+
+    std::shuffle(values.begin(), values.end(), g);
+
+    outfile << i << "\t" << time_finds(tree, values) << "\t" << time_finds(in_nodes, values) << "\t" << time_finds(apart, values);
+
+    // reads the id of the value with key k
+    auto read = [](const auto& t){
+
+      return [&t](int k){
+
+        auto it = t.find(k);
+        if(it != t.end()){ found += it->second.id; }
+      };
+    };
+
+    outfile << "\t" << time_chunks(values, read(tree)) << "\t" << time_chunks(values, read(in_nodes))
+            << "\t" << time_chunks(values, read(apart)) << std::endl;
+  }
+}
+
+
+// ============================== MAIN ===============================
+//
+// Without arguments the find benchmark is performed, otherwise the name
+// of the benchmark to perform can be given:
+//   find             unbalanced, balanced and frozen tree vs std::map
+//   allocation       default vs pooled allocation of the nodes
+//   self_balancing   unbalanced vs red-black tree
+//   bulk_load        building a tree out of sorted pairs
+//   descending       scan of the largest keys
+//   btree            red-black tree vs B-tree on large trees
+//   find_many        one by one vs batched look-ups
+//   string_keys      string look-ups with and without std::less<>
+//   range_scan       range queries of varying selectivity
+//   order_statistics cost and benefit of the subtree sizes
+//   heavy_values     emplace vs try_emplace with a costly value type
+//   sorted_input     plain vs hinted insertion of increasing keys
+//   node_handles     moving entries between trees: copies vs extract/merge
+//   set_operations   split/join set operations vs std algorithms
+//   parallel_build   building a tree from unsorted pairs with threads
+//   concurrent       throughput of a shared tree vs reader/writer ratio
+//   persistent       path-copying updates vs the mutable red-black tree
+//   parallel_traversal parallel_for_each/parallel_reduce on 10M nodes
+//   save_load        loading a saved tree vs inserting its pairs again
+//   mapped           opening and cold/warm look-ups of a mapped tree
+//   compact          bytes per node and speed of the index-linked tree
+//   large_values     look-ups with 200-byte values kept in or out of the nodes
+
+int main(int argc, char* argv[]){
+
+  std::string mode{argc > 1 ? argv[1] : "find"};
+
+  if(mode == "find"){
+
+    find_benchmark();
+
+  }else if(mode == "allocation"){
+
+    allocation_benchmark();
+
+  }else if(mode == "self_balancing"){
+
+    self_balancing_benchmark();
+
+  }else if(mode == "bulk_load"){
+
+    bulk_load_benchmark();
+
+  }else if(mode == "descending"){
+
+    descending_benchmark();
+
+  }else if(mode == "btree"){
+
+    btree_benchmark();
+
+  }else if(mode == "find_many"){
+
+    find_many_benchmark();
+
+  }else if(mode == "string_keys"){
+
+    string_keys_benchmark();
+
+  }else if(mode == "range_scan"){
+
+    range_scan_benchmark();
+
+  }else if(mode == "order_statistics"){
+
+    order_statistics_benchmark();
+
+  }else if(mode == "heavy_values"){
+
+    heavy_values_benchmark();
+
+  }else if(mode == "sorted_input"){
+
+    sorted_input_benchmark();
+
+  }else if(mode == "node_handles"){
+
+    node_handles_benchmark();
+
+  }else if(mode == "set_operations"){
+
+    set_operations_benchmark();
+
+  }else if(mode == "parallel_build"){
+
+    parallel_build_benchmark();
+
+  }else if(mode == "concurrent"){
+
+    concurrent_benchmark();
+
+  }else if(mode == "persistent"){
+
+    persistent_benchmark();
+
+  }else if(mode == "parallel_traversal"){
+
+    parallel_traversal_benchmark();
+
+  }else if(mode == "save_load"){
+
+    save_load_benchmark();
+
+  }else if(mode == "mapped"){
+
+    mapped_benchmark();
+
+  }else if(mode == "compact"){
+
+    compact_benchmark();
+
+  }else if(mode == "large_values"){
+
+    large_values_benchmark();
+
+  }else{
+
+    std::cerr << "Unknown benchmark: " << mode << std::endl;
+    return 1;
   }
-  
-  outfile_tree.close();
-  outfile_balanced.close();
-  outfile_map.close();
 
+  return 0;
 }
@@ -3,26 +3,43 @@
 #include <vector>
 #include <memory>
 #include <iterator>
+#include <stdexcept>
+#include <string>
+#include <sstream>
+#include <cstdio>
+#include <cstdint>
+#include <fstream>
+#include <thread>
+#include <atomic>
 #include "bst.hpp"
+#include "btree.hpp"
+#include "concurrent.hpp"
+#include "persistent.hpp"
+#include "compact.hpp"
+#include "mapped.hpp"
 
 // ============================== TEST ===============================
 //
 // We perform a series of tests to make sure that all the functions
 // implemented in the bst class are working as expected.
+// The scenarios shared by all the containers with the interface of bst
+// are written once, for a generic tree_type, and run against each of
+// them; the features specific to bst are tested in main.
 
-int main(){
+template<template<typename...> class tree_type>
+void scenarios(){
 
   // CREATION OF EMPTY BST
   std::cout << "========== EMPTY BINARY SEARCH TREE =========\n";
   std::cout << "We expect an empty output:\n\n";
   
-  bst<int, char> tree;
+  tree_type<int, char> tree;
   std::cout << tree << std::endl;
   
   // bst with different comparison operator
   
   std::cout << "Test building an empty tree with a different comparison operator:\n\n";
-  bst<int, char, std::greater<int> > gtree;
+  tree_type<int, char, std::greater<int> > gtree;
   std::cout << gtree << std::endl;
   
   // INSERTION 
@@ -71,7 +88,7 @@ int main(){
   
   // EMPLACE
 
-  bst<int, char> tree2;
+  tree_type<int, char> tree2;
   std::cout << "\n========== EMPLACE ==========\n";
   std::cout << "We expect the same tree as before.\n";
     
@@ -210,7 +227,7 @@ int main(){
 
   std::cout<<"\nTree obtained with Copy Constructor:\n";
 
-  bst<int, char> tree3{tree};
+  tree_type<int, char> tree3{tree};
 
   std::cout << tree3 << std::endl;
   std::cout << "Nodes:\n";
@@ -218,16 +235,27 @@ int main(){
 
   std::cout<<"\nTree obtained with Copy Assignment:\n";
   
-  bst<int, char> tree4;
+  tree_type<int, char> tree4;
   tree4 = tree;
 
   std::cout << tree4 << std::endl;
   std::cout << "Nodes:\n";
   tree4.print();
 
+  std::cout<<"\nCopies of an empty tree (we expect empty outputs):\n";
+
+  tree_type<int, char> empty_tree;
+  tree_type<int, char> empty_copy{empty_tree};
+
+  std::cout << empty_copy << std::endl;
+
+  empty_copy = empty_tree;
+
+  std::cout << empty_copy << std::endl;
+
   std::cout<<"\nTree obtained with Move Constructor:\n";
 
-  bst<int, char> tree5{std::move(tree3)};
+  tree_type<int, char> tree5{std::move(tree3)};
 
   std::cout << tree5 << std::endl;
   std::cout << "Nodes:\n";
@@ -240,7 +268,7 @@ int main(){
 
   std::cout<<"\nTree obtained with Move Assignment:\n";
   
-  bst<int, char> tree6;
+  tree_type<int, char> tree6;
   tree6 = std::move(tree4);
    
   std::cout << tree6 << std::endl;
@@ -385,7 +413,7 @@ int main(){
   tree.print();
 
   std::cout<<"\nUsing the implemented method the balanced tree shpuld be:\n";
-  std::cout<<"     7\n   /  \\ \n  3    10\n / \\   / \\ \n1   4 8  13\n     \\    \\ \n      6   14" << std::endl;
+  std::cout<<"        8\n      /   \\ \n     6     13\n    / \\   /  \\ \n   3   7 10  14\n  / \\ \n 1   4" << std::endl;
 
   tree.balance();  
   
@@ -393,6 +421,893 @@ int main(){
   std::cout << tree << std::endl;
   std::cout << "Nodes:\n";
   tree.print();
+}
+
+// type whose copy throws once copies are disabled, and whose default
+// construction throws once a budget is exhausted (-1 for no budget), to
+// test that a failed copy or allocation leaves the tree as it was
+struct fragile{
+
+  static bool fail;
+  static int budget;
+  int v{0};
+
+  fragile(){ if(budget == 0){ throw std::runtime_error{"default"}; } if(budget > 0){ --budget; } }
+  fragile(int x): v{x} {}
+  fragile(const fragile& x): v{x.v} { if(fail){ throw std::runtime_error{"copy"}; } }
+  fragile& operator=(const fragile& x){ if(fail){ throw std::runtime_error{"copy"}; } v = x.v; return *this; }
+
+  friend bool operator<(const fragile& a, const fragile& b) noexcept{ return a.v < b.v; }
+};
+
+bool fragile::fail{false};
+int fragile::budget{-1};
+
+int main(){
+
+  scenarios<bst>();
+
+  std::cout<<"\nBalancing only moves the nodes, so it also works with a move-only value type:\n";
+
+  bst<int, std::unique_ptr<int>> utree;
+
+  for(int i{1}; i <= 7; ++i){
+
+    utree.insert(std::make_pair(i, std::unique_ptr<int>(new int{i*i})));
+  }
+
+  utree.balance();
+
+  for(const auto& i : utree){
+
+    std::cout << i.first << " -> " << *i.second << "\n";
+  }
+
+  // RANGE CONSTRUCTORS
+  std::cout<<"\n========== RANGE CONSTRUCTORS ==========\n";
+  std::cout<<"\nWe build a tree out of the sorted keys of the previous tree, we expect:\n";
+  std::cout<<"     7\n   /  \\ \n  3    10\n / \\   / \\ \n1   4 8  13\n     \\    \\ \n      6   14" << std::endl;
+
+  std::vector<std::pair<int, char>> sorted_pairs{ {1, 'a'}, {3, 'c'}, {4, 'd'}, {6, 'f'}, {7, 'g'},
+                                                  {8, 'h'}, {10, 'l'}, {13, 'o'}, {14, 'p'} };
+
+  bst<int, char> stree{sorted_unique, sorted_pairs.begin(), sorted_pairs.end()};
+
+  std::cout<<"\nObtained tree:\n";
+  std::cout << stree << std::endl;
+  std::cout << "Nodes:\n";
+  stree.print();
+
+  std::cout<<"\nWe build a tree out of unsorted pairs with a repeated key (3),";
+  std::cout<<" only the first one should be kept:\n";
+
+  std::vector<std::pair<int, char>> unsorted_pairs{ {8, 'h'}, {3, 'c'}, {10, 'l'}, {3, 'z'}, {1, 'a'} };
+
+  bst<int, char> utree2{unsorted_pairs.begin(), unsorted_pairs.end()};
+
+  std::cout << utree2 << std::endl;
+
+  // REVERSE ITERATION
+  std::cout<<"\n========== REVERSE ITERATION ==========\n";
+  std::cout<<"\nWe traverse the previous tree from the largest to the smallest key:\n";
+
+  for(auto i = stree.crbegin(); i != stree.crend(); ++i){
+
+    std::cout << i->first << " ";
+  }
+
+  std::cout<<"\n\nThe last three keys, stepping back from end() (expected 14 13 10):\n";
+
+  auto back = stree.end();
+
+  for(int i{0}; i < 3; ++i){
+
+    --back;
+    std::cout << back->first << " ";
+  }
+
+  std::cout<<"\n\nStepping back from find(7) (expected 6 4 3 1):\n";
+
+  auto from = stree.find(7);
+
+  while(from != stree.begin()){
+
+    --from;
+    std::cout << from->first << " ";
+  }
+
+  std::cout << std::endl;
+
+  // FREEZE
+  std::cout<<"\n========== FREEZE ==========\n";
+  std::cout<<"\nWe take a read-only snapshot of the previous tree:\n";
+
+  auto frozen = stree.freeze();
+
+  std::cout << frozen << std::endl;
+
+  std::cout << "We look for a key that we know is present (13): ";
+
+  auto ffound = frozen.find(13);
+
+  if(ffound != frozen.end()){ std::cout << "returned key: " << ffound->first << " returned value: " << ffound->second << std::endl; }
+  else{ std::cout << "key not found" << std::endl; }
+
+  std::cout << "We look for a key that we know is not present (5): ";
+
+  if(frozen.find(5) == frozen.end()){ std::cout << "key not found, returned end()" << std::endl; }
+  else{ std::cout << "unknown behaviour" << std::endl; }
+
+  std::cout << "First key not less than 5 (expected 6): " << frozen.lower_bound(5)->first << std::endl;
+
+  // ORDERED QUERIES
+  std::cout<<"\n========== ORDERED QUERIES ==========\n";
+  std::cout<<"\nOn the previous tree (keys 1 3 4 6 7 8 10 13 14):\n";
+
+  std::cout << "lower_bound(5) (expected 6): " << stree.lower_bound(5)->first << std::endl;
+  std::cout << "lower_bound(6) (expected 6): " << stree.lower_bound(6)->first << std::endl;
+  std::cout << "upper_bound(6) (expected 7): " << stree.upper_bound(6)->first << std::endl;
+  std::cout << "lower_bound(15) is end() (expected true): " << (stree.lower_bound(15) == stree.end()) << std::endl;
+
+  auto range8 = stree.equal_range(8);
+  std::cout << "equal_range(8) (expected 8 and 10): " << range8.first->first << " and " << range8.second->first << std::endl;
+
+  auto range5 = stree.equal_range(5);
+  std::cout << "equal_range(5) is empty (expected true): " << (range5.first == range5.second) << std::endl;
+
+  std::cout << "Pairs with keys in [4, 10) (expected 4 6 7 8): ";
+  stree.for_each_in_range(4, 10, [](const std::pair<const int, char>& p){ std::cout << p.first << " "; });
+  std::cout << std::endl;
+
+  std::cout << "We change the values of the pairs with keys in [10, 20) of a copy to 'x':\n";
+
+  decltype(stree) scopy{stree};
+
+  scopy.for_each_in_range(10, 20, [](std::pair<const int, char>& p){ p.second = 'x'; });
+  std::cout << scopy << std::endl;
+
+  // ORDER STATISTICS
+  std::cout<<"\n========== ORDER STATISTICS ==========\n";
+  std::cout<<"\nOn the same tree (keys 1 3 4 6 7 8 10 13 14):\n";
+
+  std::cout << "size() (expected 9): " << stree.size() << ", empty() (expected false): " << stree.empty() << std::endl;
+  std::cout << "nth(4), the median (expected 7): " << stree.nth(4)->first << std::endl;
+  std::cout << "nth(9) is end() (expected true): " << (stree.nth(9) == stree.end()) << std::endl;
+  std::cout << "rank(10) (expected 6): " << stree.rank(10) << ", rank(5) (expected 3): " << stree.rank(5) << std::endl;
+  std::cout << "begin() + 3 (expected 6): " << (stree.begin() + 3)->first;
+  std::cout << ", end() - 2 (expected 13): " << (stree.end() - 2)->first << std::endl;
+  std::cout << "find(4) + (-1) (expected 3): " << (stree.find(4) + (-1))->first;
+  std::cout << ", end() + (-1) (expected 14): " << (stree.end() + (-1))->first;
+  std::cout << ", find(8) -= -2 (expected 13): " << (stree.find(8) -= -2)->first << std::endl;
+  std::cout << "begin() + (-1) is end() (expected true): " << (stree.begin() + (-1) == stree.end()) << std::endl;
+  std::cout << "find(13) - find(4) (expected 5): " << stree.find(13) - stree.find(4) << std::endl;
+
+  // FIND MANY
+  std::cout<<"\n========== FIND MANY ==========\n";
+  std::cout<<"\nWe look for the keys 13 5 1 14 2 8 of the previous tree all at once,\n";
+  std::cout<<"we expect o, not found, a, p, not found, h:\n";
+
+  std::vector<int> many_keys{13, 5, 1, 14, 2, 8};
+  std::vector<bst<int, char>::iterator> many_found;
+
+  stree.find_many(many_keys.begin(), many_keys.end(), std::back_inserter(many_found));
+
+  for(std::size_t i{0}; i < many_keys.size(); ++i){
+
+    std::cout << many_keys[i] << ": ";
+
+    if(many_found[i] != stree.end()){ std::cout << many_found[i]->second << "\n"; }
+    else{ std::cout << "not found\n"; }
+  }
+
+  // an input range, read once, with more keys than a group
+  std::istringstream many_input{"1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19 20"};
+  std::vector<bst<int, char>::iterator> input_found;
+
+  stree.find_many(std::istream_iterator<int>{many_input}, std::istream_iterator<int>{}, std::back_inserter(input_found));
+
+  std::size_t input_hits{0};
+  bool input_right{input_found.size() == 20};
+
+  for(std::size_t i{0}; i < input_found.size(); ++i){
+
+    if(input_found[i] != stree.end()){ ++input_hits; input_right = input_right && input_found[i]->first == int(i+1); }
+  }
+
+  std::cout << "Keys 1 to 20 read from a stream, found and right (expected 9 true): " << input_hits;
+  std::cout << " " << std::boolalpha << input_right << std::endl;
+
+  // TRANSPARENT COMPARATORS
+  std::cout<<"\n========== TRANSPARENT COMPARATORS ==========\n";
+  std::cout<<"\nWith std::less<> as comparison operator string keys can be looked for\n";
+  std::cout<<"and erased through a const char*, without building a std::string:\n";
+
+  bst<std::string, int, std::less<>> words;
+
+  words.insert(std::pair<std::string, int>("cherry", 3));
+  words.insert(std::pair<std::string, int>("apple", 1));
+  words.insert(std::pair<std::string, int>("banana", 2));
+
+  std::cout << "find(\"banana\") (expected 2): " << words.find("banana")->second << std::endl;
+  std::cout << "count(\"kiwi\") (expected 0): " << words.count("kiwi") << std::endl;
+
+  words.erase("apple");
+
+  std::cout << "After erase(\"apple\"):\n" << words << std::endl;
+
+  auto frozen_words = words.freeze();
+
+  std::cout << "In the frozen snapshot, lower_bound(\"b\") (expected banana): " << frozen_words.lower_bound("b")->first << std::endl;
+
+  // TRY EMPLACE and INSERT OR ASSIGN
+  std::cout<<"\n========== TRY EMPLACE and INSERT OR ASSIGN ==========\n";
+  std::cout<<"\nThe value is constructed inside the node from the given arguments,\n";
+  std::cout<<"and only if the key is not present:\n";
+
+  bst<int, std::string> names;
+
+  auto te = names.try_emplace(2, 3, 'b');
+  std::cout << "try_emplace(2, 3, 'b') (expected bbb, true): " << te.first->second << ", " << te.second << std::endl;
+  te = names.try_emplace(2, 5, 'z');
+  std::cout << "try_emplace(2, 5, 'z') (expected bbb, false): " << te.first->second << ", " << te.second << std::endl;
+
+  auto ia = names.insert_or_assign(1, "one");
+  std::cout << "insert_or_assign(1, \"one\") (expected one, true): " << ia.first->second << ", " << ia.second << std::endl;
+  ia = names.insert_or_assign(2, "two");
+  std::cout << "insert_or_assign(2, \"two\") (expected two, false): " << ia.first->second << ", " << ia.second << std::endl;
+
+  std::cout << "names[3] is empty (expected true): " << names[3].empty() << ", size() (expected 3): " << names.size() << std::endl;
+
+  bst<int, std::unique_ptr<int>> owners;
+  std::unique_ptr<int> owned{new int{42}};
+
+  owners.try_emplace(1, new int{1});
+  owners.try_emplace(1, std::move(owned));
+  std::cout << "A move-only argument is not taken when the key is present (expected 42): " << *owned << std::endl;
+  owners.insert_or_assign(1, std::move(owned));
+  std::cout << "but it is by insert_or_assign (expected 42 and true): " << *owners[1] << " and " << (owned == nullptr) << std::endl;
+
+  // HINTED INSERTION
+  std::cout<<"\n========== HINTED INSERTION ==========\n";
+  std::cout<<"\nWe append the keys 10 20 30 40 at end(), then put 25 before 30 and 35\n";
+  std::cout<<"after 30, and finally give a wrong hint for 5 and an existing key (20):\n";
+
+  bst<int, char> hinted;
+
+  for(int k{10}; k <= 40; k += 10){ hinted.insert(hinted.end(), std::make_pair(k, 'a')); }
+
+  auto thirty = hinted.find(30);
+  hinted.emplace_hint(thirty, 25, 'b');
+  hinted.emplace_hint(thirty, 35, 'c');
+  auto five = hinted.insert(hinted.end(), std::make_pair(5, 'd'));
+  auto twenty = hinted.emplace_hint(hinted.begin(), 20, 'z');
+
+  std::cout << "Keys in order (expected 5 10 20 25 30 35 40):";
+  for(const auto& i : hinted){ std::cout << " " << i.first; }
+  std::cout << "\nReturned iterators (expected 5 and 20 a): " << five->first << " and " << twenty->first << " " << twenty->second << std::endl;
+
+  // NODE HANDLES
+  std::cout<<"\n========== NODE HANDLES ==========\n";
+  std::cout<<"\nWe move 20 from the hinted tree to a new one through a node handle,\n";
+  std::cout<<"then merge the hinted tree into a tree holding 5 and 50:\n";
+
+  bst<int, char> moved;
+
+  auto handle = hinted.extract(20);
+  std::cout << "Extracted key and value (expected 20 a): " << handle.key() << " " << handle.mapped() << std::endl;
+
+  auto moved_in = moved.insert(std::move(handle));
+  std::cout << "Inserted (expected true, and an empty handle): " << moved_in.inserted << ", " << moved_in.node.empty() << std::endl;
+  std::cout << "extract(21) is empty (expected true): " << hinted.extract(21).empty() << std::endl;
+
+  bst<int, char, std::less<>> thandles;
+  thandles.insert(std::make_pair(2, 'b'));
+  thandles.insert(std::make_pair(1, 'a'));
+
+  auto tfirst = thandles.extract(thandles.begin());
+  auto tlong = thandles.extract(2L);
+  std::cout << "With std::less<>, extract(begin()) and extract(2L) (expected 1 a 2 b 0): " << tfirst.key() << " " << tfirst.mapped();
+  std::cout << " " << tlong.key() << " " << tlong.mapped() << " " << thandles.size() << std::endl;
+
+  bst<int, char> merged;
+  merged.insert(std::make_pair(5, 'x'));
+  merged.insert(std::make_pair(50, 'y'));
+  merged.merge(hinted);
+
+  std::cout << "Merged pairs (expected 5 x 10 a 25 b 30 a 35 c 40 a 50 y):";
+  for(const auto& i : merged){ std::cout << " " << i.first << " " << i.second; }
+  std::cout << "\nLeft in the hinted tree, the conflicting key (expected 5 d): ";
+  for(const auto& i : hinted){ std::cout << i.first << " " << i.second; }
+  std::cout << "\nSizes (expected 7 and 1): " << merged.size() << " and " << hinted.size() << std::endl;
+
+  // SPLIT, JOIN and SET OPERATIONS
+  std::cout<<"\n========== SPLIT, JOIN and SET OPERATIONS ==========\n";
+  std::cout<<"\nThe trees are moved in, so their nodes are reused:\n";
+
+  rb_bst<int, char> evens, thirds;
+
+  for(int k{0}; k < 20; k += 2){ evens.insert(std::make_pair(k, 'e')); }
+  for(int k{0}; k < 20; k += 3){ thirds.insert(std::make_pair(k, 't')); }
+
+  auto halves = split(rb_bst<int, char>(evens), 10);
+  std::cout << "split(evens, 10) (expected 0 2 4 6 8 | 10 12 14 16 18):";
+  for(const auto& i : halves.first){ std::cout << " " << i.first; }
+  std::cout << " |";
+  for(const auto& i : halves.second){ std::cout << " " << i.first; }
+
+  auto joined = join(std::move(halves.first), std::move(halves.second));
+  std::cout << "\njoin of the halves, size (expected 10): " << joined.size() << std::endl;
+
+  try{
+
+    join(rb_bst<int, char>(thirds), rb_bst<int, char>(evens));
+
+  }catch(const std::invalid_argument&){
+
+    std::cout << "join of overlapping trees throws std::invalid_argument (expected true): true" << std::endl;
+  }
+
+  auto united = set_union(rb_bst<int, char>(evens), rb_bst<int, char>(thirds));
+  std::cout << "union (expected 0e 2e 3t 4e 6e 8e 9t 10e 12e 14e 15t 16e 18e):";
+  for(const auto& i : united){ std::cout << " " << i.first << i.second; }
+
+  auto common = set_intersection(rb_bst<int, char>(thirds), rb_bst<int, char>(evens));
+  std::cout << "\nintersection (expected 0t 6t 12t 18t):";
+  for(const auto& i : common){ std::cout << " " << i.first << i.second; }
+
+  auto only_evens = set_difference(std::move(evens), std::move(thirds));
+  std::cout << "\ndifference (expected 2 4 8 10 14 16):";
+  for(const auto& i : only_evens){ std::cout << " " << i.first; }
+  std::cout << "\nThe operands are left empty (expected 0 0): " << evens.size() << " " << thirds.size() << std::endl;
+
+  // PARALLEL BUILD
+  std::cout<<"\n========== PARALLEL BUILD ==========\n";
+
+  std::vector<std::pair<int, int>> unsorted;
+  for(int i = 0; i < 100000; ++i){ unsorted.emplace_back((i * 7919) % 60000, i); }
+
+  bst<int, int> serial(unsorted.begin(), unsorted.end());
+  bst<int, int> parallel(parallel_build, unsorted.begin(), unsorted.end(), 4);
+  rb_bst<int, int> parallel_rb(parallel_build, unsorted.begin(), unsorted.end(), 8);
+
+  std::cout << "Sizes (expected 60000 60000 60000): " << serial.size() << " " << parallel.size() << " " << parallel_rb.size() << std::endl;
+
+  bool same{true};
+  auto p = parallel.begin();
+  auto q = parallel_rb.begin();
+  for(const auto& i : serial){ same = same && *p == i && *q == i; ++p; ++q; }
+  std::cout << "Same pairs as the serial build, first ones kept (expected true): " << std::boolalpha << same << std::endl;
+
+  bool ranked{true};
+  std::size_t k{0};
+  for(auto i = parallel_rb.begin(); i != parallel_rb.end(); ++i, ++k){ ranked = ranked && parallel_rb.nth(k) == i; }
+  std::cout << "Subtree sizes consistent, nth(k) is the k-th pair (expected true): " << ranked << std::endl;
+
+  bst<int, int> single(parallel_build, unsorted.begin(), unsorted.begin() + 5, 1);
+  std::cout << "Built by a single thread (expected 0:0 7919:1 15838:2 23757:3 31676:4):";
+  for(const auto& i : single){ std::cout << " " << i.first << ":" << i.second; }
+  std::cout << std::noboolalpha << std::endl;
+
+  // SAVE and LOAD
+  std::cout<<"\n========== SAVE and LOAD ==========\n";
+
+  bst<int, double> saved{};
+  for(int i : {5, 3, 8, 1, 4, 7, 9}){ saved.insert(std::pair<const int, double>{i, i / 2.0}); }
+
+  std::stringstream raw_file{};
+  saved.save(raw_file);
+
+  rb_bst<int, double> loaded{};
+  loaded.insert(std::pair<const int, double>{42, 0});
+  loaded.load(raw_file);
+  std::cout << "Loaded tree (expected 1:0.5 3:1.5 4:2 5:2.5 7:3.5 8:4 9:4.5):";
+  for(const auto& i : loaded){ std::cout << " " << i.first << ":" << i.second; }
+  std::cout << std::endl;
+  std::cout << "Size and median (expected 7 5): " << loaded.size() << " " << loaded.nth(3)->first << std::endl;
+
+  bst<std::string, std::string> colours{};
+  colours["pear"] = "green";
+  colours["apple"] = "";
+  colours["fig"] = "purple";
+
+  std::stringstream text_file{};
+  colours.save(text_file);
+
+  bst<std::string, std::string> colours_loaded{};
+  colours_loaded.load(text_file);
+  std::cout << "Loaded strings (expected apple: fig:purple pear:green):";
+  for(const auto& i : colours_loaded){ std::cout << " " << i.first << ":" << i.second; }
+  std::cout << std::endl;
+
+  try{
+
+    std::stringstream wrong_file{};
+    saved.save(wrong_file);
+    colours_loaded.load(wrong_file);
+
+  }catch(const std::runtime_error&){
+
+    std::cout << "Loading another type throws std::runtime_error (expected true): true" << std::endl;
+  }
+
+  bst<int, float> floats{};
+  floats.insert(std::pair<const int, float>{1, 0.5f});
+
+  std::stringstream float_file{};
+  floats.save(float_file);
+
+  try{
+
+    bst<float, int> swapped{};
+    swapped.load(float_file);
+
+  }catch(const std::runtime_error&){
+
+    std::cout << "Loading <int, float> as <float, int> throws (expected true): true" << std::endl;
+  }
+
+  try{
+
+    float_file.seekg(0);
+    bst<unsigned, float> unsigned_keys{};
+    unsigned_keys.load(float_file);
+
+  }catch(const std::runtime_error&){
+
+    std::cout << "Loading <int, float> as <unsigned, float> throws (expected true): true" << std::endl;
+  }
+
+  try{
+
+    std::stringstream truncated{raw_file.str().substr(0, 40)};
+    loaded.load(truncated);
+
+  }catch(const std::runtime_error&){
+
+    std::cout << "Truncated data throw, the tree is unchanged (expected 7): " << loaded.size() << std::endl;
+  }
+
+  // MAPPED TREE
+  std::cout<<"\n========== MAPPED TREE ==========\n";
+
+  rb_bst<int, double> to_map{};
+  for(int i = 1; i <= 10; ++i){ to_map.insert(std::pair<const int, double>{3*i, i / 4.0}); }
+
+  mapped_bst<int, double>::write("mapped_test.bin", to_map.freeze());
+
+  {
+    mapped_bst<int, double> mapped{"mapped_test.bin"};
+
+    std::cout << "Size and find(9) (expected 10 0.75): " << mapped.size() << " " << mapped.find(9)->second << std::endl;
+    std::cout << "find(10) is end() (expected true): " << std::boolalpha << (mapped.find(10) == mapped.end()) << std::noboolalpha << std::endl;
+
+    std::cout << "Keys in [7, 16) (expected 9 12 15):";
+    for(auto i = mapped.lower_bound(7), stop = mapped.lower_bound(16); i != stop; ++i){ std::cout << " " << i->first; }
+
+    std::cout << "\nKeys after 24, through upper_bound (expected 27 30):";
+    for(auto i = mapped.upper_bound(24); i != mapped.end(); ++i){ std::cout << " " << (*i).first; }
+
+    mapped_bst<int, double> moved_map{std::move(mapped)};
+    std::cout << "\nAll the keys, after a move (expected 3 6 9 12 15 18 21 24 27 30):";
+    for(const auto& i : moved_map){ std::cout << " " << i.first; }
+    std::cout << std::endl;
+  }
+
+  try{
+
+    mapped_bst<long, double> wrong_map{"mapped_test.bin"};
+
+  }catch(const std::runtime_error&){
+
+    std::cout << "Mapping a file of another type throws std::runtime_error (expected true): true" << std::endl;
+  }
+
+  {
+    // a corrupt header whose offset of the values makes the end of the
+    // values wrap around to a small number
+    std::fstream corrupt{"mapped_test.bin", std::ios::in | std::ios::out | std::ios::binary};
+    std::uint64_t huge_offset{~std::uint64_t{63}};
+
+    corrupt.seekp(40);
+    corrupt.write(reinterpret_cast<const char*>(&huge_offset), sizeof(huge_offset));
+  }
+
+  try{
+
+    mapped_bst<int, double> corrupt_map{"mapped_test.bin"};
+
+  }catch(const std::runtime_error&){
+
+    std::cout << "Mapping a file with a corrupt header throws std::runtime_error (expected true): true" << std::endl;
+  }
+
+  std::remove("mapped_test.bin");
+
+  // PARALLEL TRAVERSAL
+  std::cout<<"\n========== PARALLEL TRAVERSAL ==========\n";
+
+  std::vector<std::pair<int, long>> ranked_pairs;
+  for(int i = 0; i < 100000; ++i){ ranked_pairs.emplace_back(i, i); }
+
+  rb_bst<int, long> visited(sorted_unique, ranked_pairs.begin(), ranked_pairs.end());
+
+  visited.parallel_for_each([](std::pair<const int, long>& x){ x.second *= 2; }, 4);
+
+  auto twice = [](const std::pair<const int, long>& x){ return x.second; };
+  auto plus = [](long a, long b){ return a + b; };
+
+  std::cout << "Sum of the doubled values with 1 and 8 threads (expected 9999900000 9999900000): "
+            << visited.parallel_reduce(0L, twice, plus, 1) << " " << visited.parallel_reduce(0L, twice, plus, 8) << std::endl;
+
+  auto digit = [](const std::pair<const int, long>& x){ return std::string(1, char('0' + x.first % 10)); };
+  auto concatenate = [](std::string a, const std::string& b){ return a += b; };
+
+  std::string in_order{};
+  for(const auto& i : visited){ in_order += digit(i); }
+
+  std::cout << "Non-commutative reduction in order with 3 threads (expected true): " << std::boolalpha
+            << (visited.parallel_reduce(std::string{}, digit, concatenate, 3) == in_order) << std::noboolalpha << std::endl;
+  std::cout << "Reduction of an empty tree gives init (expected 7): " << rb_bst<int, long>{}.parallel_reduce(7L, twice, plus) << std::endl;
+
+  // CONCURRENT TREE
+  std::cout<<"\n========== CONCURRENT TREE ==========\n";
+
+  concurrent_bst<int, int> shared{};
+
+  for(int i = 0; i < 1000; ++i){ shared.insert(std::pair<const int, int>{2*i, i}); }
+
+  std::cout << "insert of a present key (expected false): " << std::boolalpha << shared.insert(std::pair<const int, int>{0, 1}) << std::endl;
+  std::cout << "find(10) (expected 5): " << *shared.find(10) << ", find(11) has a value (expected false): " << shared.find(11).has_value() << std::endl;
+
+  std::atomic<bool> readers_ok{true};
+  std::vector<std::thread> threads;
+
+  for(int r = 0; r < 2; ++r){
+
+    threads.emplace_back([&shared, &readers_ok](){
+
+      for(int round = 0; round < 20; ++round){
+
+        for(int i = 0; i < 1000; ++i){ if(shared.find(2*i) != i){ readers_ok = false; } }
+
+        shared.for_each([&readers_ok](const std::pair<const int, int>& x){ if(x.first % 2 == 0 && x.second != x.first/2){ readers_ok = false; } });
+      }
+    });
+  }
+
+  for(int w = 0; w < 2; ++w){
+
+    threads.emplace_back([&shared, w](){
+
+      for(int i = w; i < 1000; i += 2){ shared.emplace(2*i+1, -1); }
+      for(int i = w; i < 1000; i += 4){ shared.erase(2*i+1); }
+    });
+  }
+
+  for(auto& t : threads){ t.join(); }
+
+  std::cout << "Readers always found the even keys (expected true): " << readers_ok << std::endl;
+  std::cout << "Size after the writers (expected 1500): " << shared.size() << std::endl;
+  std::cout << "Largest key, through read() (expected 1999): " << shared.read([](const rb_bst<int, int>& t){ return (--t.cend())->first; }) << std::endl;
+  std::cout << "erase(5) then erase(5) (expected true false): " << shared.erase(5) << " " << shared.erase(5) << std::noboolalpha << std::endl;
+
+  // PERSISTENT TREE
+  std::cout<<"\n========== PERSISTENT TREE ==========\n";
+
+  persistent_bst<int, std::string> versioned{};
+
+  for(int i = 1; i <= 5; ++i){ versioned.insert(std::pair<const int, std::string>{i, std::string(i, 'a')}); }
+
+  auto old_version = versioned.snapshot();
+
+  versioned.erase(2);
+  versioned.insert_or_assign(3, "c");
+  versioned.emplace(6, "f");
+
+  std::cout << "Current version (expected 1:a 3:c 4:aaaa 5:aaaaa 6:f ): " << versioned << std::endl;
+  std::cout << "Snapshot taken before the changes (expected 1:a 2:aa 3:aaa 4:aaaa 5:aaaaa ): " << old_version << std::endl;
+  std::cout << "Sizes (expected 5 5): " << versioned.size() << " " << old_version.size() << std::endl;
+  std::cout << "lower_bound(2) in both (expected 3 2): " << versioned.lower_bound(2)->first << " " << old_version.lower_bound(2)->first << std::endl;
+
+  persistent_bst<int, int> increasing{};
+  for(int i = 0; i < 1000; ++i){ increasing.insert(std::pair<const int, int>{i, i}); }
+  std::cout << "Height after 1000 increasing keys (expected 10): " << increasing.height() << std::endl;
+
+  // one writer inserts and then erases increasing keys while three readers
+  // take snapshots: each must hold a whole version, i.e. consecutive keys,
+  // as many as its size
+  persistent_bst<int, int> published{};
+  std::atomic<bool> writer_done{false}, snapshots_ok{true};
+  std::vector<std::thread> snapshot_threads;
+
+  for(int r = 0; r < 3; ++r){
+
+    snapshot_threads.emplace_back([&published, &writer_done, &snapshots_ok](){
+
+      while(!writer_done){
+
+        auto version = published.snapshot();
+        std::size_t count{0};
+        int previous{0};
+
+        for(const auto& i : version){
+
+          if(count > 0 && i.first != previous + 1){ snapshots_ok = false; }
+          if(i.second != i.first){ snapshots_ok = false; }
+          previous = i.first;
+          ++count;
+        }
+
+        if(count != version.size()){ snapshots_ok = false; }
+      }
+    });
+  }
+
+  for(int i = 0; i < 2000; ++i){ published.insert(std::pair<const int, int>{i, i}); }
+  for(int i = 0; i < 1500; ++i){ published.erase(i); }
+
+  writer_done = true;
+
+  for(auto& t : snapshot_threads){ t.join(); }
+
+  std::cout << "Snapshots taken during the changes hold whole versions (expected true): " << std::boolalpha << snapshots_ok;
+  std::cout << ", final size (expected 500): " << published.size() << std::noboolalpha << std::endl;
+
+  // COMPACT TREE
+  std::cout<<"\n========== COMPACT TREE ==========\n";
+
+  compact_bst<int, std::string> indexed{};
+
+  for(int i = 1; i <= 5; ++i){ indexed.insert(std::pair<const int, std::string>{i, std::string(i, 'a')}); }
+
+  std::cout << "Inserting a key already there (expected 0): " << indexed.emplace(3, "c") << std::endl;
+
+  indexed.erase(2);
+  indexed[3] = "c";
+  indexed[6] = "f";
+  (*indexed.find(4)).second = "d";
+
+  std::cout << "Tree (expected 1:a 3:c 4:d 5:aaaaa 6:f ): " << indexed << std::endl;
+  std::cout << "Size, count(2) and lower_bound(2) (expected 5 0 3): " << indexed.size() << " " << indexed.count(2)
+            << " " << indexed.lower_bound(2)->first << std::endl;
+
+  compact_bst<int, int> dense{};
+  for(int i = 0; i < 1000; ++i){ dense.insert(std::pair<const int, int>{i, i}); }
+  std::cout << "Height after 1000 increasing keys (expected 10): " << dense.height() << std::endl;
+
+  for(int i = 0; i < 1000; i += 2){ dense.erase(i); }
+
+  long odd_sum{0};
+  for(const auto& i : dense){ odd_sum += i.first; }
+
+  std::cout << "After erasing the even keys, size and sum of the keys (expected 500 250000): " << dense.size() << " " << odd_sum << std::endl;
+
+  compact_bst<int, int> moved_dense{std::move(dense)};
+  std::cout << "Moved-from tree: size and find(5) (expected 0 1): " << dense.size() << " " << (dense.find(5) == dense.end()) << std::endl;
+
+  dense.insert(std::pair<const int, int>{5, 5});
+  dense = std::move(moved_dense);
+  std::cout << "After moving back, sizes and find(5) in the two trees (expected 500 0 1 1): " << dense.size() << " " << moved_dense.size();
+  std::cout << " " << (dense.find(5) != dense.end()) << " " << (moved_dense.find(5) == moved_dense.end()) << std::endl;
+
+  compact_bst<int, std::string, std::less<int>, std::allocator<std::pair<const int, std::string>>, separate_values> apart{};
+
+  for(int i = 1; i <= 5; ++i){ apart.emplace(i, std::string(i, 'b')); }
+
+  apart.erase(1);
+  apart[2] = "x";
+  (*apart.find(5)).second = "y";
+
+  std::cout << "Values kept apart from the keys (expected 2:x 3:bbb 4:bbbb 5:y ): " << apart << std::endl;
+
+  // SELF-BALANCING TREE
+  std::cout<<"\n========== SELF-BALANCING TREE ==========\n";
+  std::cout<<"\nWe insert the keys from 1 to 10 in increasing order in a red-black tree,\n";
+  std::cout<<"instead of a list we expect the following tree:\n";
+  std::cout<<"     4\n   /   \\ \n  2     6\n / \\   / \\ \n1   3 5   8\n         / \\ \n        7   9\n             \\ \n              10" << std::endl;
+
+  rb_bst<int, char> rbtree;
+
+  for(int i{1}; i <= 10; ++i){
+
+    rbtree.insert(std::pair<int, char>(i, 'a'+i-1));
+  }
+
+  std::cout<<"\nObtained tree:\n";
+  std::cout << rbtree << std::endl;
+  std::cout << "Nodes:\n";
+  rbtree.print();
+
+  std::cout<<"\nWe erase the root (4) and node 8, the tree should rebalance as:\n";
+  std::cout<<"     5\n   /   \\ \n  2     9\n / \\   / \\ \n1   3 6   10\n       \\ \n        7" << std::endl;
+
+  rbtree.erase(4);
+  rbtree.erase(8);
+
+  std::cout<<"\nObtained tree:\n";
+  std::cout << rbtree << std::endl;
+  std::cout << "Nodes:\n";
+  rbtree.print();
+
+  // POOL ALLOCATOR
+  std::cout<<"\n========== POOL ALLOCATOR ==========\n";
+  std::cout<<"\nWe build the same tree with nodes taken from a pool_allocator:\n";
+
+  bst<int, char, std::less<int>, pool_allocator<std::pair<const int, char>>> ptree;
+
+  ptree.insert(std::pair<int, char>(8, 'h'));
+  ptree.insert(std::pair<int, char>(10, 'l'));
+  ptree.insert(std::pair<int, char>(3, 'c'));
+  ptree.insert(std::pair<int, char>(6, 'f'));
+  ptree.insert(std::pair<int, char>(4, 'd'));
+  ptree.insert(std::pair<int, char>(1, 'a'));
+  ptree.insert(std::pair<int, char>(14, 'p'));
+  ptree.insert(std::pair<int, char>(13, 'o'));
+  ptree.insert(std::pair<int, char>(7, 'g'));
+
+  std::cout << ptree << std::endl;
+  std::cout << "Nodes taken from the pool (expected 9): " << ptree.get_allocator().in_use() << std::endl;
+
+  ptree.erase(6);
+  ptree.erase(13);
+  std::cout << "After erasing 6 and 13 (expected 7): " << ptree.get_allocator().in_use() << std::endl;
+
+  decltype(ptree) pcopy{ptree};
+  std::cout << "The copy has its own pool (expected 7 and 7): " << ptree.get_allocator().in_use();
+  std::cout << " and " << pcopy.get_allocator().in_use() << std::endl;
+
+  ptree.clear();
+  std::cout << "After clear the whole pool is released (expected 0): " << ptree.get_allocator().in_use() << std::endl;
+  std::cout << "while the copy is untouched:\n" << pcopy << std::endl;
+
+  std::vector<int, pool_allocator<int>> pvec(pool_allocator<int>{});
+  pvec.push_back(1);
+  auto pmoved = std::move(pvec);
+  pvec.push_back(2);
+  std::cout << "A moved-from allocator still works and shares the arena (expected 1 2 true): " << pmoved[0];
+  std::cout << " " << pvec[0] << " " << std::boolalpha << (pvec.get_allocator() == pmoved.get_allocator()) << std::endl;
+
+  std::cout<<"\nTrees with pools of their own cannot share nodes, so joining them\n";
+  std::cout<<"or taking their difference moves the pairs of the second one:\n";
+
+  std::vector<std::pair<int, char>> lows, highs;
+
+  for(int k{0}; k < 20000; ++k){ (k < 10000 ? lows : highs).push_back(std::make_pair(k, 'p')); }
+
+  decltype(ptree) plow{sorted_unique, lows.begin(), lows.end()};
+  decltype(ptree) phigh{sorted_unique, highs.begin(), highs.end()};
+
+  auto pjoined = join(std::move(plow), std::move(phigh));
+  std::cout << "Size of the join and nodes in its pool (expected 20000 20000): " << pjoined.size();
+  std::cout << " " << pjoined.get_allocator().in_use() << std::endl;
+
+  std::vector<std::pair<int, char>> odds;
+
+  for(int k{1}; k < 20000; k += 2){ odds.push_back(std::make_pair(k, 'o')); }
+
+  decltype(ptree) podds{sorted_unique, odds.begin(), odds.end()};
+
+  auto pevens = set_difference(std::move(pjoined), std::move(podds));
+  std::cout << "Size of the difference, its first keys, nodes in its pool and in the one of the odds (expected 10000 0 2 4 10000 0): ";
+  std::cout << pevens.size() << " " << pevens.begin()->first << " " << std::next(pevens.begin())->first;
+  std::cout << " " << std::next(pevens.begin(), 2)->first << " " << pevens.get_allocator().in_use();
+  std::cout << " " << podds.get_allocator().in_use() << std::endl;
+
+  std::cout<<"\nNodes cannot move between pools either, so merge and the insertion of\n";
+  std::cout<<"a node handle move the pairs in new nodes and free the old ones:\n";
+
+  decltype(ptree) pfirst, psecond, pthird;
+
+  for(int k{1}; k <= 5; ++k){ pfirst.insert(std::make_pair(k, 'a')); }
+  for(int k{4}; k <= 8; ++k){ psecond.insert(std::make_pair(k, 'b')); }
+
+  pfirst.merge(psecond);
+  std::cout << "After merge (expected 1a 2a 3a 4a 5a 6b 7b 8b | 4b 5b):";
+  for(const auto& i : pfirst){ std::cout << " " << i.first << i.second; }
+  std::cout << " |";
+  for(const auto& i : psecond){ std::cout << " " << i.first << i.second; }
+  std::cout << "\nNodes in the two pools (expected 8 2): " << pfirst.get_allocator().in_use() << " " << psecond.get_allocator().in_use() << std::endl;
+
+  auto phandle = pfirst.insert(psecond.extract(4));
+  std::cout << "Handle with a key already present, still full (expected 0 1): " << phandle.inserted << " " << !phandle.node.empty() << std::endl;
+
+  phandle = pthird.insert(std::move(phandle.node));
+  std::cout << "Handle given to a third tree, nodes in the second and third pools (expected 1 1 1): " << phandle.inserted;
+  std::cout << " " << psecond.get_allocator().in_use() << " " << pthird.get_allocator().in_use() << std::endl;
+
+  // B-TREE
+  std::cout<<"\n========== B-TREE ==========\n";
+  std::cout<<"\nWe run the same scenarios against btree: the traversals should not change,\n";
+  std::cout<<"while print() shows the nodes of the B-tree level by level.\n\n";
+
+  scenarios<btree>();
+
+  std::cout<<"\nWe insert the keys from 1 to 1000 in a scrambled order, so that nodes are split,\n";
+  std::cout<<"and then erase the even ones, so that nodes are merged:\n";
+
+  btree<int, int> big;
+
+  for(int i{0}; i < 1000; ++i){
+
+    int k{(i*389) % 1000 + 1};
+    big.insert(std::pair<int, int>(k, -k));
+  }
+
+  for(int i{2}; i <= 1000; i += 2){ big.erase(i); }
+
+  int expected{1};
+  bool ordered{true};
+
+  for(const auto& i : big){
+
+    ordered = ordered && i.first == expected && i.second == -expected;
+    expected += 2;
+  }
+
+  std::cout << "Number of keys (expected 500): " << big.size() << std::endl;
+  std::cout << "Odd keys in order with their values (expected true): " << std::boolalpha << ordered << std::endl;
+  std::cout << "Largest key, stepping back from end() (expected 999): " << (--big.end())->first << std::endl;
+  std::cout << "Looking for 500 and 501 (expected false and true): " << (big.find(500) != big.end());
+  std::cout << " and " << (big.find(501) != big.end()) << std::endl;
+
+  btree<int, fragile> fsource, ftarget;
+
+  for(int i{0}; i < 1000; ++i){ fsource.insert(std::pair<int, fragile>(i, fragile{i})); }
+  for(int i{0}; i < 10; ++i){ ftarget.insert(std::pair<int, fragile>(-i, fragile{-i})); }
+
+  fragile::fail = true;
+
+  try{
+
+    ftarget = fsource;
+    std::cout << "Copy assignment with a throwing copy did not throw (expected false)" << std::endl;
+
+  }catch(const std::runtime_error&){
+
+    bool intact{ftarget.size() == 10};
+    int k{-9};
+
+    for(const auto& i : ftarget){ intact = intact && i.first == k && i.second.v == k; ++k; }
+
+    std::cout << "Copy assignment throwing halfway, the target is unchanged (expected true): " << intact << std::endl;
+  }
+
+  fragile::fail = false;
+
+  ftarget = fsource;
+  std::cout << "Copy assignment, keys and largest value (expected 1000 999): " << ftarget.size();
+  std::cout << " " << (--ftarget.end())->second.v << std::endl;
+
+  // a node holds 32 keys of 4 bytes: the 33rd key splits the root leaf,
+  // which needs a new leaf and a new root, each default constructing 32
+  // keys; the budget lets the leaf be built and makes the root throw
+
+  btree<fragile, int> fsplit;
+
+  for(int i{0}; i < 32; ++i){ fsplit.insert(std::pair<fragile, int>(fragile{i}, i)); }
+
+  fragile::budget = 32;
+
+  try{
+
+    fsplit.insert(std::pair<fragile, int>(fragile{32}, 32));
+    std::cout << "Splitting with a throwing allocation did not throw (expected false)" << std::endl;
+
+  }catch(const std::runtime_error&){
+
+    int k{0};
+    bool kept{true};
+
+    for(const auto& i : fsplit){ kept = kept && i.first.v == k && i.second == k; ++k; }
+
+    std::cout << "Split throwing on the new root, size and keys unchanged (expected 32 true): " << fsplit.size();
+    std::cout << " " << (kept && k == 32) << std::endl;
+  }
+
+  fragile::budget = -1;
+
+  fsplit.insert(std::pair<fragile, int>(fragile{32}, 32));
+  std::cout << "The split then succeeds (expected 33 32): " << fsplit.size() << " " << (--fsplit.end())->second << std::endl;
 
   return 0;
 }